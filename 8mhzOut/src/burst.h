@@ -0,0 +1,84 @@
+/*
+ * burst.h
+ *
+ * Created: 10/21/2026 3:47:30 PM
+ *  Author: odinh
+ */
+
+
+#ifndef BURST_H_
+#define BURST_H_
+
+// pattern bursts on PORTC.  The CONF_BURST_PATTERN table in flash is copied to RAM and played out by a fully
+// unrolled ld/out sequence (MREPEAT) with interrupts off, one sample every CONF_BURST_CYCLES CPU cycles - 3 is
+// the floor (ld 2, out 1), 2.67 MS/s at 8 MHz.  Repeated bursts follow each other straight away with a fixed
+// BURST_GAP_CYCLES added to the last sample of each pass (movw, sbiw, brne), so the timing of every edge is
+// known to the cycle.  out writes the whole port, the pattern is masked to CONF_BURST_MASK
+#define BURST_GAP_CYCLES 5
+
+#if CONF_BURST_LENGTH < 1 || CONF_BURST_LENGTH > MREPEAT_LIMIT
+#error "CONF_BURST_LENGTH is 1 to MREPEAT_LIMIT samples"
+#endif
+#if CONF_BURST_CYCLES < 3 || CONF_BURST_CYCLES > 10
+#error "CONF_BURST_CYCLES is 3 to 10"
+#endif
+
+// padding after each out to make up CONF_BURST_CYCLES, rjmp .+0 is two cycles in one word
+#define BURST_PAD_3 ""
+#define BURST_PAD_4 "nop\n\t"
+#define BURST_PAD_5 "rjmp .+0\n\t"
+#define BURST_PAD_6 "rjmp .+0\n\t" "nop\n\t"
+#define BURST_PAD_7 "rjmp .+0\n\t" "rjmp .+0\n\t"
+#define BURST_PAD_8 "rjmp .+0\n\t" "rjmp .+0\n\t" "nop\n\t"
+#define BURST_PAD_9 "rjmp .+0\n\t" "rjmp .+0\n\t" "rjmp .+0\n\t"
+#define BURST_PAD_10 "rjmp .+0\n\t" "rjmp .+0\n\t" "rjmp .+0\n\t" "nop\n\t"
+#define BURST_PAD(cycles) TPASTE2(BURST_PAD_, cycles)
+#define BURST_SAMPLE(n, data) "ld __tmp_reg__, X+\n\t" "out %[port], __tmp_reg__\n\t" BURST_PAD(CONF_BURST_CYCLES)
+
+const uint8_t BurstPattern[CONF_BURST_LENGTH] PROGMEM = CONF_BURST_PATTERN;
+
+uint8_t BurstBuffer[CONF_BURST_LENGTH];
+
+// prototypes
+void initializeBurst(void);
+void burstPlay(unsigned int count);
+
+void initializeBurst(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < CONF_BURST_LENGTH; i++)
+	{
+		BurstBuffer[i] = pgm_read_byte(&BurstPattern[i]) & CONF_BURST_MASK;
+	}
+	PORTC = BurstBuffer[CONF_BURST_LENGTH - 1];
+	DDRC |= CONF_BURST_MASK;
+}
+
+// play the pattern count times back to back, nothing else runs (the UART included) until it is done
+void burstPlay(unsigned int count)
+{
+	uint8_t *pointer = BurstBuffer;
+	irqflags_t flags;
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	flags = cpu_irq_save();
+	// the outputs are early clobber so [start] never shares X or count, it holds the same value as pointer going in
+	asm volatile(
+		"1:\n\t"
+		MREPEAT(CONF_BURST_LENGTH, BURST_SAMPLE, ~)
+		"movw r26, %[start]\n\t"
+		"sbiw %[count], 1\n\t"
+		"brne 1b\n\t"
+		: [count] "+&w" (count), "+&x" (pointer)
+		: [port] "I" (_SFR_IO_ADDR(PORTC)), [start] "r" (BurstBuffer)
+		: "memory"
+	);
+	cpu_irq_restore(flags);
+}
+
+#endif /* BURST_H_ */
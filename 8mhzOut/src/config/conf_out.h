@@ -0,0 +1,38 @@
+/*
+ * conf_out.h
+ *
+ * Created: 10/21/2026 8:32:17 AM
+ *  Author: odinh
+ */
+
+
+#ifndef CONF_OUT_H_
+#define CONF_OUT_H_
+
+// power up output on OC1A (PB1), F_CPU / 2 (4 MHz) at most.  Anything other than a 50% duty needs one of
+// the PWM modes, which go up to F_CPU / 4.  The shell (f) changes both and reports what the timer achieved
+#define CONF_OUT_HZ 4000000UL
+#define CONF_OUT_DUTY 50
+
+// phase locked outputs (phase), each channel runs at the base frequency divided by its divider - the default
+// is a crank signal on PB1 and PD6 and a cam signal at half the rate on PB3
+#define CONF_PHASE_DIVIDERS { 1, 1, 2 }
+
+// pattern bursts on PORTC (burst), CONF_BURST_LENGTH samples (up to 256) every CONF_BURST_CYCLES CPU cycles
+// (3 to 10).  Only the CONF_BURST_MASK pins are outputs, PC6 is RESET
+#define CONF_BURST_LENGTH 16
+#define CONF_BURST_PATTERN { 0x01, 0x00, 0x01, 0x00, 0x03, 0x02, 0x03, 0x02, 0x07, 0x06, 0x05, 0x04, 0x3F, 0x00, 0x2A, 0x00 }
+#define CONF_BURST_CYCLES 3
+#define CONF_BURST_MASK 0x3F
+
+// a sweep (sweep) starts over at the first frequency when it gets to the end, 0 holds the last one
+#define CONF_SWEEP_REPEAT 1
+
+// measurement defaults, the gate of count (ms) and the number of periods period averages over
+#define CONF_COUNTER_GATE_MS 1000
+#define CONF_COUNTER_PERIODS 16
+
+// command shell on USART0 (PD0, PD1)
+#define CONF_UART_BAUD 38400
+
+#endif /* CONF_OUT_H_ */
@@ -0,0 +1,158 @@
+/*
+ * counter.h
+ *
+ * Created: 10/22/2026 9:14:51 AM
+ *  Author: odinh
+ */
+
+
+#ifndef COUNTER_H_
+#define COUNTER_H_
+
+// frequency and period measurement, referenced to this board's F_CPU.  counterGate() counts rising edges on T1
+// (PD5) with Timer1 clocked from the pin, over a gate of whole milliseconds from Timer2 (CTC, 1 kHz) - good
+// for fast signals, the input can go up to about F_CPU / 2.5.  counterPeriod() time stamps rising edges on ICP1
+// (PB0) with Timer1 at F_CPU and averages over a number of periods - good for slow ones, a 125 ns resolution
+// per measurement whatever the frequency.  Point either at a known output of the Blink board (a wave output
+// or the 'U' stream the oscillator calibration uses) to see how far its RC oscillator is off.  Both take
+// Timer1 and Timer2 away from the outputs, the output setting is put back afterwards
+#define COUNTER_GATE_OCR 124 // F_CPU / 64 / 125 = 1 kHz
+#define COUNTER_TIMEOUT_MS 3000 // beyond the gate or the periods
+
+volatile unsigned int CounterOverflows; // Timer1 overflows, the top half of the count
+volatile unsigned int CounterTicks; // gate milliseconds or captured edges so far
+volatile unsigned int CounterLength; // gate milliseconds or periods to measure
+volatile unsigned long CounterStart;
+volatile unsigned long CounterEnd;
+volatile bool IsCounterDone;
+
+// prototypes
+bool counterGate(unsigned int ms, unsigned long *edges);
+bool counterPeriod(unsigned int periods, unsigned long *ticks);
+bool counterWait(unsigned int ms);
+unsigned long counterStamp(unsigned int count);
+void counterStop(void);
+
+// rising edges on T1 over ms milliseconds, false when the gate never closed
+bool counterGate(unsigned int ms, unsigned long *edges)
+{
+	bool isDone;
+
+	counterStop();
+	CounterLength = ms;
+	TIMSK1 = (1<<TOIE1);
+	TCCR1B = (1<<CS12) | (1<<CS11) | (1<<CS10); // T1, rising edge
+
+	ASSR = 0;
+	TCCR2A = (1<<WGM21); // CTC
+	OCR2A = COUNTER_GATE_OCR;
+	TCNT2 = 0;
+	TIFR2 = (1<<OCF2A);
+	TIMSK2 = (1<<OCIE2A);
+	TCCR2B = (1<<CS22); // /64
+
+	isDone = counterWait(ms);
+	counterStop();
+	*edges = CounterEnd - CounterStart;
+	return isDone;
+}
+
+// Timer1 ticks (1 / F_CPU) over periods rising edges on ICP1, false when they did not all come
+bool counterPeriod(unsigned int periods, unsigned long *ticks)
+{
+	bool isDone;
+
+	counterStop();
+	CounterLength = periods;
+	TIFR1 = (1<<ICF1) | (1<<TOV1);
+	TIMSK1 = (1<<ICIE1) | (1<<TOIE1);
+	TCCR1B = (1<<ICNC1) | (1<<ICES1) | (1<<CS10); // noise canceler, rising edge, F_CPU
+
+	isDone = counterWait(0);
+	counterStop();
+	*ticks = CounterEnd - CounterStart;
+	return isDone;
+}
+
+bool counterWait(unsigned int ms)
+{
+	unsigned long waited;
+
+	for (waited = 0; !IsCounterDone && waited < (unsigned long)ms + COUNTER_TIMEOUT_MS; waited++)
+	{
+		_delay_ms(1);
+	}
+	return IsCounterDone;
+}
+
+// the 32-bit Timer1 count of a 16-bit reading taken in an interrupt, with an overflow that is still pending
+// counted when the reading is from after it
+unsigned long counterStamp(unsigned int count)
+{
+	unsigned int overflows = CounterOverflows;
+
+	if ((TIFR1 & (1<<TOV1)) && count < 0x8000)
+	{
+		overflows++;
+	}
+	return ((unsigned long)overflows << 16) | count;
+}
+
+// both timers stopped and cleared for the next measurement or for the outputs
+void counterStop(void)
+{
+	TCCR1B = 0;
+	TCCR2B = 0;
+	TIMSK1 = 0;
+	TIMSK2 = 0;
+	TCCR1A = 0;
+	TCCR2A = 0;
+	TCNT1 = 0;
+	TIFR1 = (1<<ICF1) | (1<<TOV1) | (1<<OCF1A) | (1<<OCF1B);
+	TIFR2 = (1<<OCF2A) | (1<<OCF2B) | (1<<TOV2);
+	CounterOverflows = 0;
+	CounterTicks = 0;
+	IsCounterDone = false;
+}
+
+ISR(TIMER1_OVF_vect)
+{
+	CounterOverflows++;
+}
+
+// gate milliseconds, the first one opens the gate.  The interrupt latency is the same at both ends
+ISR(TIMER2_COMPA_vect)
+{
+	unsigned long stamp = counterStamp(TCNT1);
+
+	if (CounterTicks == 0)
+	{
+		CounterStart = stamp;
+	}
+	else if (CounterTicks == CounterLength)
+	{
+		CounterEnd = stamp;
+		IsCounterDone = true;
+		TIMSK2 = 0;
+	}
+	CounterTicks++;
+}
+
+ISR(TIMER1_CAPT_vect)
+{
+	unsigned long stamp = counterStamp(ICR1);
+
+	if (CounterTicks == 0)
+	{
+		CounterStart = stamp;
+	}
+	else if (CounterTicks == CounterLength)
+	{
+		CounterEnd = stamp;
+		IsCounterDone = true;
+		TIMSK1 = 0;
+	}
+	CounterTicks++;
+}
+
+#endif /* COUNTER_H_ */
@@ -28,9 +28,24 @@
 /*
  * Support and FAQ: visit <a href="http://www.atmel.com/design-support/">Atmel Support</a>
  */
-#include <asf.h>
+#define F_CPU 8000000UL
 
-#define F_CPU 8000000;
+#include <asf.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+#include <string.h>
+#include <math.h>
+#include <mrepeat.h>
+#include <conf_out.h>
+#include <uart.h>
+#include <output.h>
+#include <phase.h>
+#include <burst.h>
+#include <counter.h>
+#include <sweep.h>
+#include <shell.h>
 
 int main (void)
 {
@@ -40,11 +55,19 @@ int main (void)
 
 	/* Insert application code here, after the board has been initialized. */
 
-	DDRB |= (1<<DDB0);
-	PORTB |= 1;
+	initializeOutput();
+	initializePhase();
+	initializeBurst();
+	outputSet(CONF_OUT_HZ, CONF_OUT_DUTY);
+	shellInitialize();
+	sei();
+	shellOutput();
+	shellPrompt();
 
 	while(true)
 	{
-		PORTB ^= 1<<PINB0;
+		// Timer1 drives the output on its own
+		sweepPoll();
+		shellPoll();
 	}
 }
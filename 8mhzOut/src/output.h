@@ -0,0 +1,187 @@
+/*
+ * output.h
+ *
+ * Created: 10/21/2026 8:35:02 AM
+ *  Author: odinh
+ */
+
+
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+// Timer1 signal on OC1A (PB1), generated by the timer without the CPU.  outputSet() searches every mode and
+// prescaler for the TOP that comes closest to the requested frequency and duty cycle:
+//   toggle         CTC, OC1A toggles at TOP, 50% only          F_CPU / (2 * N * (TOP + 1)), up to F_CPU / 2
+//   fast PWM       TOP = ICR1, set at BOTTOM, clear at OCR1A   F_CPU / (N * (TOP + 1)), up to F_CPU / 4
+//   phase correct  TOP = ICR1, symmetric pulses                F_CPU / (2 * N * TOP)
+// A clock at the full F_CPU is only available on CLKO (PB0) by programming the CKOUT fuse
+#define OUTPUT_PRESCALERS 5
+#define OUTPUT_TOGGLE 0
+#define OUTPUT_FAST 1
+#define OUTPUT_PHASE 2
+#define OUTPUT_MODES 3
+#define OUTPUT_PWM_MIN_TOP 3 // the smallest TOP the PWM modes allow
+#define OUTPUT_PPB 1000000000ULL
+
+const unsigned int OutputPrescalers[OUTPUT_PRESCALERS] = { 1, 8, 64, 256, 1024 }; // CS12:0 = 1 to 5
+
+struct OutputSetting
+{
+	unsigned char Mode;
+	unsigned char Prescaler; // index into OutputPrescalers
+	unsigned int Top;
+	unsigned int Compare;
+	unsigned long Steps; // timer counts per pass, the duty resolution
+	unsigned long Divisor; // F_CPU ticks per output period
+	unsigned long High; // F_CPU ticks the output is high per period
+	unsigned long Error; // frequency error, parts per billion
+	bool IsAbove; // the frequency came out above the request
+};
+
+struct OutputSetting Output; // what Timer1 runs now
+
+// prototypes
+void initializeOutput(void);
+bool outputSet(unsigned long hz, unsigned char duty);
+bool outputSearch(unsigned long hz, unsigned char duty, struct OutputSetting *best);
+void outputApply(struct OutputSetting *setting);
+unsigned long outputMilliHz(struct OutputSetting *setting);
+unsigned int outputDutyPermille(struct OutputSetting *setting);
+
+void initializeOutput(void)
+{
+	PORTB &= ~(1<<PINB1);
+	DDRB |= (1<<DDB1);
+}
+
+// the closest hz (and duty in percent) the timer can make, false when nothing fits
+bool outputSet(unsigned long hz, unsigned char duty)
+{
+	struct OutputSetting setting;
+
+	if (!outputSearch(hz, duty, &setting))
+	{
+		return false;
+	}
+	outputApply(&setting);
+	return true;
+}
+
+bool outputSearch(unsigned long hz, unsigned char duty, struct OutputSetting *best)
+{
+	struct OutputSetting candidate;
+	unsigned long periods, divisor;
+	unsigned long long product, error;
+
+	if (hz == 0 || hz > F_CPU / 2 || duty > 100)
+	{
+		return false;
+	}
+
+	best->Divisor = 0;
+	for (candidate.Mode = 0; candidate.Mode < OUTPUT_MODES; candidate.Mode++)
+	{
+		if (candidate.Mode == OUTPUT_TOGGLE && duty != 50)
+		{
+			continue;
+		}
+		for (candidate.Prescaler = 0; candidate.Prescaler < OUTPUT_PRESCALERS; candidate.Prescaler++)
+		{
+			// timer counts per output period, toggle and phase correct take two passes through the counter
+			periods = candidate.Mode == OUTPUT_FAST ? 1 : 2;
+			divisor = (unsigned long)OutputPrescalers[candidate.Prescaler] * periods;
+			candidate.Steps = (F_CPU + (unsigned long long)hz * divisor / 2) / ((unsigned long long)hz * divisor);
+			if (candidate.Mode == OUTPUT_PHASE ? candidate.Steps > 65535UL : candidate.Steps > 65536UL)
+			{
+				continue;
+			}
+			if (candidate.Steps < (candidate.Mode == OUTPUT_TOGGLE ? 1 : OUTPUT_PWM_MIN_TOP + (candidate.Mode == OUTPUT_FAST)))
+			{
+				continue;
+			}
+
+			candidate.Top = candidate.Mode == OUTPUT_PHASE ? candidate.Steps : candidate.Steps - 1;
+			candidate.Divisor = divisor * candidate.Steps;
+			product = (unsigned long long)hz * candidate.Divisor;
+			candidate.IsAbove = product < F_CPU;
+			error = candidate.IsAbove ? F_CPU - product : product - F_CPU;
+			candidate.Error = error * OUTPUT_PPB / product;
+
+			// Compare is the number of counts the output is high for, outputApply() turns it into OCR1A
+			if (candidate.Mode == OUTPUT_TOGGLE)
+			{
+				candidate.Compare = candidate.Top;
+				candidate.High = candidate.Divisor / 2;
+			}
+			else
+			{
+				candidate.Compare = (candidate.Steps * duty + 50) / 100;
+				candidate.High = candidate.Compare * divisor;
+			}
+
+			// the closest frequency, then the finest duty steps
+			if (best->Divisor == 0 || candidate.Error < best->Error
+				|| (candidate.Error == best->Error && candidate.Steps > best->Steps))
+			{
+				*best = candidate;
+			}
+		}
+	}
+	return best->Divisor != 0;
+}
+
+void outputApply(struct OutputSetting *setting)
+{
+	unsigned char com = (1<<COM1A1); // non-inverting
+
+	// stopped while it is set up
+	TCCR1B = 0;
+	TCNT1 = 0;
+	switch (setting->Mode)
+	{
+	case OUTPUT_TOGGLE:
+		TCCR1A = (1<<COM1A0);
+		OCR1A = setting->Top;
+		TCCR1B = (1<<WGM12) | (setting->Prescaler + 1); // CTC, TOP = OCR1A
+		break;
+	case OUTPUT_FAST:
+		// fast PWM is high for one count even at OCR1A 0, a duty of 0 or 100 is left to the port
+		if (setting->Compare == 0 || setting->Compare > setting->Top)
+		{
+			com = 0;
+		}
+		TCCR1A = com | (1<<WGM11);
+		ICR1 = setting->Top;
+		OCR1A = setting->Compare > 0 ? setting->Compare - 1 : 0;
+		TCCR1B = (1<<WGM13) | (1<<WGM12) | (setting->Prescaler + 1); // mode 14
+		break;
+	default:
+		TCCR1A = com | (1<<WGM11);
+		ICR1 = setting->Top;
+		OCR1A = setting->Compare;
+		TCCR1B = (1<<WGM13) | (setting->Prescaler + 1); // mode 10
+		break;
+	}
+
+	if (setting->High == 0)
+	{
+		PORTB &= ~(1<<PINB1);
+	}
+	else if (setting->High >= setting->Divisor)
+	{
+		PORTB |= (1<<PINB1);
+	}
+	Output = *setting;
+}
+
+unsigned long outputMilliHz(struct OutputSetting *setting)
+{
+	return (unsigned long)((F_CPU * 1000ULL + setting->Divisor / 2) / setting->Divisor);
+}
+
+unsigned int outputDutyPermille(struct OutputSetting *setting)
+{
+	return (unsigned int)((setting->High * 1000ULL + setting->Divisor / 2) / setting->Divisor);
+}
+
+#endif /* OUTPUT_H_ */
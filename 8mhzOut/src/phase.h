@@ -0,0 +1,169 @@
+/*
+ * phase.h
+ *
+ * Created: 10/21/2026 1:18:55 PM
+ *  Author: odinh
+ */
+
+
+#ifndef PHASE_H_
+#define PHASE_H_
+
+// phase locked square waves from all three timers, crank and cam style.  Channel 0 is Timer1 on OC1A (PB1),
+// channel 1 Timer0 on OC0A (PD6), channel 2 Timer2 on OC2A (PB3), each in CTC toggle mode at the base
+// frequency divided by its CONF_PHASE_DIVIDERS entry and delayed by its own phase (degrees of its own period).
+// The phases are set up by preloading the counters and the starting output levels while GTCCR.TSM holds both
+// prescalers in reset, clearing TSM then starts all three on the same clock.  That only works through the
+// prescaler, so the counters run at F_CPU / 8 or slower and the base frequency is at most F_CPU / 16.  Timer0
+// and Timer2 are 8-bit, which sets the lowest frequency - at /1024 a channel with a divider of 1 goes down to
+// F_CPU / 2^19
+#define PHASE_CHANNELS 3
+#define PHASE_PRESCALERS 4
+
+const unsigned int PhasePrescalers[PHASE_PRESCALERS] = { 8, 64, 256, 1024 };
+const unsigned char PhaseCs[PHASE_PRESCALERS] = { 2, 3, 4, 5 }; // CSn2:0 of Timer0 and Timer1
+const unsigned char PhaseCs2[PHASE_PRESCALERS] = { 2, 4, 6, 7 }; // CS22:0, Timer2 has more steps
+const unsigned char PhaseDividers[PHASE_CHANNELS] = CONF_PHASE_DIVIDERS;
+const unsigned long PhaseLimits[PHASE_CHANNELS] = { 65536UL, 256, 256 }; // counts per half period
+
+unsigned char PhasePrescaler; // index into PhasePrescalers
+unsigned long PhaseHalf[PHASE_CHANNELS]; // counts per half period
+unsigned long PhaseDelay[PHASE_CHANNELS]; // counts each channel lags its own zero phase, what the counters got
+bool IsPhaseRunning;
+
+// prototypes
+void initializePhase(void);
+bool phaseStart(unsigned long hz, const long *degrees);
+void phaseStop(void);
+void phaseLevel(volatile uint8_t *control, volatile uint8_t *force, uint8_t forceBit, uint8_t comShift, bool isHigh);
+unsigned long phaseMilliHz(void);
+unsigned int phaseDecidegrees(int channel);
+
+void initializePhase(void)
+{
+	PORTD &= ~(1<<PIND6);
+	DDRD |= (1<<DDD6);
+	PORTB &= ~(1<<PINB3);
+	DDRB |= (1<<DDB3);
+}
+
+// hz is the channel 0 frequency with a divider of 1, false when it can not be made
+bool phaseStart(unsigned long hz, const long *degrees)
+{
+	unsigned long half = 0, advance[PHASE_CHANNELS], count;
+	unsigned char p, s;
+	irqflags_t flags;
+
+	if (hz == 0 || hz > F_CPU / (2UL * PhasePrescalers[0]))
+	{
+		return false;
+	}
+
+	// the smallest prescaler every channel fits in gives the finest phase steps
+	for (p = 0; p < PHASE_PRESCALERS; p++)
+	{
+		half = (F_CPU + hz * PhasePrescalers[p]) / (2 * hz * PhasePrescalers[p]);
+		for (s = 0; s < PHASE_CHANNELS && half > 0 && half * PhaseDividers[s] <= PhaseLimits[s]; s++)
+		{
+		}
+		if (s == PHASE_CHANNELS && half > 0)
+		{
+			break;
+		}
+	}
+	if (p == PHASE_PRESCALERS)
+	{
+		return false;
+	}
+
+	PhasePrescaler = p;
+	for (s = 0; s < PHASE_CHANNELS; s++)
+	{
+		PhaseHalf[s] = half * PhaseDividers[s];
+		count = 2 * PhaseHalf[s];
+		PhaseDelay[s] = ((unsigned long)(degrees[s] % 360 + 360) % 360 * count + 180) / 360 % count;
+		// a channel that lags by d is one that is already count - d into its period
+		advance[s] = (count - PhaseDelay[s]) % count;
+		if (advance[s] % PhaseHalf[s] == PhaseHalf[s] - 1 && PhaseHalf[s] > 1)
+		{
+			// writing TCNT blocks the compare match on the next timer clock, a counter preloaded with its own
+			// compare value would miss its toggle and run all the way round.  One count early instead
+			advance[s] = (advance[s] + 1) % count;
+			PhaseDelay[s] = (count - advance[s]) % count;
+		}
+	}
+
+	flags = cpu_irq_save();
+	// hold both prescalers in reset, the counters only step once TSM is cleared
+	GTCCR = (1<<TSM) | (1<<PSRSYNC) | (1<<PSRASY);
+	TCCR1B = 0;
+	TCCR0B = 0;
+	TCCR2B = 0;
+
+	// in the second half of the period a channel starts high
+	TCCR1A = 0;
+	phaseLevel(&TCCR1A, &TCCR1C, FOC1A, COM1A0, advance[0] >= PhaseHalf[0]);
+	OCR1A = PhaseHalf[0] - 1;
+	TCNT1 = advance[0] % PhaseHalf[0];
+
+	TCCR0A = (1<<WGM01); // CTC
+	phaseLevel(&TCCR0A, &TCCR0B, FOC0A, COM0A0, advance[1] >= PhaseHalf[1]);
+	OCR0A = PhaseHalf[1] - 1;
+	TCNT0 = advance[1] % PhaseHalf[1];
+
+	ASSR = 0;
+	TCCR2A = (1<<WGM21); // CTC
+	phaseLevel(&TCCR2A, &TCCR2B, FOC2A, COM2A0, advance[2] >= PhaseHalf[2]);
+	OCR2A = PhaseHalf[2] - 1;
+	TCNT2 = advance[2] % PhaseHalf[2];
+
+	TCCR1B = (1<<WGM12) | PhaseCs[p];
+	TCCR0B = PhaseCs[p];
+	TCCR2B = PhaseCs2[p];
+	GTCCR = 0;
+	cpu_irq_restore(flags);
+
+	IsPhaseRunning = true;
+	return true;
+}
+
+// Timer0 and Timer2 off and their pins low, Timer1 is left to whoever takes it over
+void phaseStop(void)
+{
+	TCCR0B = 0;
+	TCCR0A = 0;
+	TCCR2B = 0;
+	TCCR2A = 0;
+	PORTD &= ~(1<<PIND6);
+	PORTB &= ~(1<<PINB3);
+	IsPhaseRunning = false;
+}
+
+// connect a compare output in toggle mode, starting low or high
+void phaseLevel(volatile uint8_t *control, volatile uint8_t *force, uint8_t forceBit, uint8_t comShift, bool isHigh)
+{
+	// clear on match and force it to get a known level, then toggle from there
+	*control = (*control & ~(3 << comShift)) | (2 << comShift);
+	*force |= (1<<forceBit);
+	*control = (*control & ~(3 << comShift)) | (1 << comShift);
+	if (isHigh)
+	{
+		*force |= (1<<forceBit);
+	}
+}
+
+// channel 0 frequency
+unsigned long phaseMilliHz(void)
+{
+	unsigned long long divisor = 2ULL * PhasePrescalers[PhasePrescaler] * PhaseHalf[0];
+
+	return (unsigned long)((F_CPU * 1000ULL + divisor / 2) / divisor);
+}
+
+// the phase channel s got, tenths of a degree
+unsigned int phaseDecidegrees(int s)
+{
+	return (PhaseDelay[s] * 3600UL + PhaseHalf[s]) / (2 * PhaseHalf[s]);
+}
+
+#endif /* PHASE_H_ */
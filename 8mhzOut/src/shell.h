@@ -0,0 +1,346 @@
+/*
+ * shell.h
+ *
+ * Created: 10/21/2026 10:40:26 AM
+ *  Author: odinh
+ */
+
+
+#ifndef SHELL_H_
+#define SHELL_H_
+
+// line based command shell on USART0, every setting can be changed without reflashing
+#define SHELL_LINE_SIZE 32
+#define SHELL_MAX_ARGS 4
+
+char ShellLine[SHELL_LINE_SIZE];
+unsigned char ShellLength;
+
+// prototypes
+void shellInitialize(void);
+void shellPoll(void);
+void shellExecute(char *line);
+void shellPrompt(void);
+void shellFrequency(long *args, unsigned char argCount);
+void shellOutput(void);
+void shellPhase(long *args, unsigned char argCount);
+void shellBurst(long *args, unsigned char argCount);
+void shellCount(long *args, unsigned char argCount, bool isPeriod);
+void shellSweep(long *args, unsigned char argCount);
+void shellTimer1(void);
+char* shellParseLong(char *s, long *value);
+
+void shellInitialize(void)
+{
+	ShellLength = 0;
+	uartInitialize(CONF_UART_BAUD);
+}
+
+// called from the main loop
+void shellPoll(void)
+{
+	char c;
+
+	if (!uartGetChar(&c))
+	{
+		return;
+	}
+
+	if (c == '\r' || c == '\n')
+	{
+		if (ShellLength > 0)
+		{
+			uartPutNewLine();
+			ShellLine[ShellLength] = 0;
+			ShellLength = 0;
+			shellExecute(ShellLine);
+			shellPrompt();
+		}
+	}
+	else if (c == '\b' || c == 0x7F)
+	{
+		if (ShellLength > 0)
+		{
+			ShellLength--;
+			uartPutString_P(PSTR("\b \b"));
+		}
+	}
+	else if (ShellLength < SHELL_LINE_SIZE - 1)
+	{
+		ShellLine[ShellLength++] = c;
+		uartPutChar(c);
+	}
+}
+
+void shellExecute(char *line)
+{
+	char *command = line;
+	char *p = line;
+	long args[SHELL_MAX_ARGS];
+	unsigned char argCount = 0;
+
+	// split the command word from its numeric arguments
+	while (*p && *p != ' ')
+	{
+		p++;
+	}
+	if (*p)
+	{
+		*p++ = 0;
+	}
+	while (argCount < SHELL_MAX_ARGS && (p = shellParseLong(p, &args[argCount])) != NULL)
+	{
+		argCount++;
+	}
+
+	if (strcmp_P(command, PSTR("help")) == 0)
+	{
+		uartPutString_P(PSTR(
+			"f <hz> [<duty %>]         output hz on PB1, 50% duty by default\r\n"
+			"phase <hz> <d0> <d1> <d2>  phase locked PB1, PD6, PB3 at hz, each delayed by d degrees\r\n"
+			"sweep <hz> <hz> <ms> [<e>] sweep PB1 between the two, linear or exponential (e 1)\r\n"
+			"burst [<count>]           play the pattern on PORTC count times\r\n"
+			"count [<ms>]              count edges on T1 (PD5) over a gate of ms\r\n"
+			"period [<n>]              time n periods on ICP1 (PB0)\r\n"
+			"show                      show the output\r\n"));
+	}
+	else if (strcmp_P(command, PSTR("f")) == 0)
+	{
+		shellFrequency(args, argCount);
+	}
+	else if (strcmp_P(command, PSTR("phase")) == 0)
+	{
+		shellPhase(args, argCount);
+	}
+	else if (strcmp_P(command, PSTR("sweep")) == 0)
+	{
+		shellSweep(args, argCount);
+	}
+	else if (strcmp_P(command, PSTR("burst")) == 0)
+	{
+		shellBurst(args, argCount);
+	}
+	else if (strcmp_P(command, PSTR("count")) == 0)
+	{
+		shellCount(args, argCount, false);
+	}
+	else if (strcmp_P(command, PSTR("period")) == 0)
+	{
+		shellCount(args, argCount, true);
+	}
+	else if (strcmp_P(command, PSTR("show")) == 0)
+	{
+		shellOutput();
+	}
+	else
+	{
+		uartPutString_P(PSTR("? (help)\r\n"));
+	}
+}
+
+void shellPrompt(void)
+{
+	uartPutString_P(PSTR("> "));
+}
+
+void shellFrequency(long *args, unsigned char argCount)
+{
+	long duty = argCount > 1 ? args[1] : 50;
+
+	if (argCount < 1 || args[0] <= 0 || duty < 0 || duty > 100)
+	{
+		uartPutString_P(PSTR("f <hz> [<duty %>]\r\n"));
+		return;
+	}
+	shellTimer1();
+	if (!outputSet(args[0], duty))
+	{
+		uartPutString_P(PSTR("out of range\r\n"));
+		return;
+	}
+	shellOutput();
+}
+
+// what the timer makes and how far that is from the request
+void shellOutput(void)
+{
+	unsigned char s;
+
+	if (IsSweepRunning)
+	{
+		uartPutString_P(SweepShape == SWEEP_EXPONENTIAL ? PSTR("exponential ") : PSTR("linear "));
+		uartPutFixed((unsigned long)(SweepFrom * 1000), 3);
+		uartPutString_P(PSTR(" to "));
+		uartPutFixed((unsigned long)(SweepTo * 1000), 3);
+		uartPutString_P(PSTR(" Hz /"));
+		uartPutLong(OutputPrescalers[SweepPrescaler]);
+		uartPutString_P(PSTR(", now "));
+		uartPutFixed((unsigned long)((unsigned long long)F_CPU * 1000ULL / (2UL * OutputPrescalers[SweepPrescaler] * (SweepLoaded + 1UL))), 3);
+		uartPutString_P(PSTR(" Hz\r\n"));
+		return;
+	}
+	if (IsPhaseRunning)
+	{
+		uartPutFixed(phaseMilliHz(), 3);
+		uartPutString_P(PSTR(" Hz /"));
+		uartPutLong(PhasePrescalers[PhasePrescaler]);
+		for (s = 0; s < PHASE_CHANNELS; s++)
+		{
+			uartPutString_P(s == 0 ? PSTR("\r\nPB1 ") : s == 1 ? PSTR("\r\nPD6 ") : PSTR("\r\nPB3 "));
+			uartPutFixed(phaseDecidegrees(s), 1);
+			uartPutString_P(PSTR(" deg /"));
+			uartPutLong(PhaseDividers[s]);
+		}
+		uartPutNewLine();
+		return;
+	}
+
+	uartPutFixed(outputMilliHz(&Output), 3);
+	uartPutString_P(PSTR(" Hz "));
+	uartPutFixed(outputDutyPermille(&Output), 1);
+	uartPutString_P(PSTR("% error "));
+	uartPutChar(Output.Error == 0 ? ' ' : Output.IsAbove ? '+' : '-');
+	uartPutFixed(Output.Error, 3);
+	uartPutString_P(Output.Mode == OUTPUT_TOGGLE ? PSTR(" ppm toggle /") : Output.Mode == OUTPUT_FAST ? PSTR(" ppm fast /")
+		: PSTR(" ppm phase /"));
+	uartPutLong(OutputPrescalers[Output.Prescaler]);
+	uartPutString_P(PSTR(" top "));
+	uartPutLong(Output.Top);
+	uartPutNewLine();
+}
+
+// stop whatever runs on Timer1 and Timer2 besides the plain output
+void shellTimer1(void)
+{
+	if (IsPhaseRunning)
+	{
+		phaseStop();
+	}
+	if (IsSweepRunning)
+	{
+		sweepStop();
+	}
+}
+
+void shellSweep(long *args, unsigned char argCount)
+{
+	if (argCount < 3 || args[0] <= 0 || args[1] <= 0 || args[2] <= 0)
+	{
+		uartPutString_P(PSTR("sweep <hz> <hz> <ms> [<e>]\r\n"));
+		return;
+	}
+	shellTimer1();
+	if (!sweepStart(args[0], args[1], args[2], argCount > 3 && args[3] ? SWEEP_EXPONENTIAL : SWEEP_LINEAR))
+	{
+		uartPutString_P(PSTR("out of range\r\n"));
+		return;
+	}
+	shellOutput();
+}
+
+void shellPhase(long *args, unsigned char argCount)
+{
+	if (argCount < 1 + PHASE_CHANNELS)
+	{
+		uartPutString_P(PSTR("phase <hz> <d0> <d1> <d2>\r\n"));
+		return;
+	}
+	if (IsSweepRunning)
+	{
+		sweepStop();
+	}
+	if (args[0] <= 0 || !phaseStart(args[0], &args[1]))
+	{
+		uartPutString_P(PSTR("out of range\r\n"));
+		return;
+	}
+	shellOutput();
+}
+
+void shellBurst(long *args, unsigned char argCount)
+{
+	long count = argCount > 0 ? args[0] : 1;
+
+	if (count < 1 || count > 65535L)
+	{
+		uartPutString_P(PSTR("burst [<count>]\r\n"));
+		return;
+	}
+
+	// let the prompt out first, the UART stops while the burst plays
+	while (UartTxHead != UartTxTail);
+	burstPlay(count);
+
+	uartPutLong(CONF_BURST_LENGTH);
+	uartPutString_P(PSTR(" samples at "));
+	uartPutFixed(F_CPU / 1000UL / CONF_BURST_CYCLES, 3);
+	uartPutString_P(PSTR(" MS/s, +"));
+	uartPutLong(BURST_GAP_CYCLES);
+	uartPutString_P(PSTR(" cycles between passes\r\n"));
+}
+
+// frequency (and period) of the input, the output is stopped while it measures
+void shellCount(long *args, unsigned char argCount, bool isPeriod)
+{
+	long length = argCount > 0 ? args[0] : isPeriod ? CONF_COUNTER_PERIODS : CONF_COUNTER_GATE_MS;
+	unsigned long long milliHz;
+	unsigned long value;
+	bool isDone;
+
+	if (length < 1 || length > 60000L)
+	{
+		uartPutString_P(isPeriod ? PSTR("period [<n>]\r\n") : PSTR("count [<ms>]\r\n"));
+		return;
+	}
+
+	shellTimer1();
+	isDone = isPeriod ? counterPeriod(length, &value) : counterGate(length, &value);
+	outputApply(&Output);
+
+	if (!isDone || value == 0)
+	{
+		uartPutString_P(PSTR("no input\r\n"));
+		return;
+	}
+
+	// edges per gate or ticks per periods
+	milliHz = isPeriod ? (F_CPU * 1000ULL * length + value / 2) / value : (value * 1000000ULL + length / 2) / length;
+	uartPutFixed((unsigned long)milliHz, 3);
+	uartPutString_P(PSTR(" Hz"));
+	if (isPeriod)
+	{
+		// 125 ns ticks at 8 MHz
+		uartPutString_P(PSTR(", period "));
+		uartPutFixed((unsigned long)((value * 1000000000ULL / F_CPU + length / 2) / length), 3);
+		uartPutString_P(PSTR(" us"));
+	}
+	uartPutNewLine();
+}
+
+char* shellParseLong(char *s, long *value)
+{
+	bool isNegative = false;
+	long result = 0;
+
+	while (*s == ' ')
+	{
+		s++;
+	}
+	if (*s == '-' || *s == '+')
+	{
+		isNegative = *s++ == '-';
+	}
+	if (*s < '0' || *s > '9')
+	{
+		return NULL;
+	}
+	while (*s >= '0' && *s <= '9')
+	{
+		result = result * 10 + (*s++ - '0');
+	}
+
+	*value = isNegative ? -result : result;
+	return s;
+}
+
+#endif /* SHELL_H_ */
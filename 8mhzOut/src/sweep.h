@@ -0,0 +1,153 @@
+/*
+ * sweep.h
+ *
+ * Created: 10/22/2026 11:02:37 AM
+ *  Author: odinh
+ */
+
+
+#ifndef SWEEP_H_
+#define SWEEP_H_
+
+// frequency sweeps on OC1A (PB1), a tach signal that accelerates like the car does.  Timer1 runs in fast PWM
+// mode 15 (TOP = OCR1A) toggling OC1A at TOP, a square wave of F_CPU / (2 * N * (TOP + 1)).  OCR1A is double
+// buffered in that mode, so a new TOP only ever takes effect at BOTTOM and a late write can not make the
+// counter miss its compare and run round - no cycle is skipped or cut short.  The compare interrupt adds up the
+// time the output has run and loads the TOP sweepPoll() worked out for that time from the main loop, linear
+// or exponential in frequency between the two limits.  At the end the sweep starts over or holds the last
+// frequency (CONF_SWEEP_REPEAT).  The interrupt comes twice per period, so sweeps are meant for tach and event
+// rates up to some tens of kHz - faster than that the output is still clean but the sweep falls behind time
+#define SWEEP_LINEAR 0
+#define SWEEP_EXPONENTIAL 1
+#define SWEEP_MIN_TOP 3
+#define SWEEP_MAX_HZ (F_CPU / (2UL * (SWEEP_MIN_TOP + 1)))
+
+volatile unsigned long SweepElapsed; // timer counts the output has run for in this sweep
+volatile unsigned int SweepTop; // the next TOP, from sweepPoll()
+volatile unsigned int SweepLoaded; // the TOP last written to OCR1A
+unsigned char SweepPrescaler; // index into OutputPrescalers
+unsigned long SweepLength; // timer counts in a sweep
+float SweepFrom, SweepTo, SweepRatio; // Hz, and the log of their ratio for an exponential sweep
+unsigned char SweepShape;
+bool IsSweepRunning;
+
+// prototypes
+bool sweepStart(unsigned long from, unsigned long to, unsigned long ms, unsigned char shape);
+void sweepStop(void);
+void sweepPoll(void);
+float sweepHz(unsigned long elapsed);
+unsigned int sweepTopOf(float hz);
+
+// from and to in Hz over ms, false when the limits do not fit Timer1
+bool sweepStart(unsigned long from, unsigned long to, unsigned long ms, unsigned char shape)
+{
+	unsigned long lowest = from < to ? from : to;
+	unsigned char p;
+
+	if (lowest == 0 || from > SWEEP_MAX_HZ || to > SWEEP_MAX_HZ || ms == 0 || shape > SWEEP_EXPONENTIAL)
+	{
+		return false;
+	}
+
+	// the smallest prescaler that holds the lowest frequency gives the finest steps at the top
+	for (p = 0; p < OUTPUT_PRESCALERS; p++)
+	{
+		if (F_CPU / (2UL * OutputPrescalers[p]) / lowest <= 65536UL)
+		{
+			break;
+		}
+	}
+	if (p == OUTPUT_PRESCALERS)
+	{
+		return false;
+	}
+
+	sweepStop();
+	SweepPrescaler = p;
+	SweepLength = (unsigned long)((unsigned long long)ms * (F_CPU / 1000UL) / OutputPrescalers[p]);
+	SweepFrom = from;
+	SweepTo = to;
+	SweepRatio = logf(SweepTo / SweepFrom);
+	SweepShape = shape;
+	SweepElapsed = 0;
+	SweepTop = SweepLoaded = sweepTopOf(SweepFrom);
+
+	TCNT1 = 0;
+	OCR1A = SweepLoaded;
+	TCCR1A = (1<<COM1A0) | (1<<WGM11) | (1<<WGM10); // toggle OC1A at TOP
+	TIFR1 = (1<<OCF1A);
+	TIMSK1 = (1<<OCIE1A);
+	TCCR1B = (1<<WGM13) | (1<<WGM12) | (p + 1); // mode 15
+	IsSweepRunning = true;
+	return true;
+}
+
+// Timer1 stopped, whoever takes it over sets it up again
+void sweepStop(void)
+{
+	TIMSK1 &= ~(1<<OCIE1A);
+	TCCR1B = 0;
+	TCCR1A = 0;
+	PORTB &= ~(1<<PINB1);
+	IsSweepRunning = false;
+}
+
+// called from the main loop, works out the TOP for where the sweep is now
+void sweepPoll(void)
+{
+	unsigned long elapsed;
+	unsigned int top;
+	irqflags_t flags;
+
+	if (!IsSweepRunning)
+	{
+		return;
+	}
+
+	flags = cpu_irq_save();
+	elapsed = SweepElapsed;
+	if (elapsed >= SweepLength && CONF_SWEEP_REPEAT)
+	{
+		SweepElapsed = elapsed = 0;
+	}
+	cpu_irq_restore(flags);
+
+	// the float math runs with interrupts on, the interrupt keeps loading the previous TOP meanwhile
+	top = sweepTopOf(sweepHz(elapsed));
+	flags = cpu_irq_save();
+	SweepTop = top;
+	cpu_irq_restore(flags);
+}
+
+// the frequency elapsed timer counts into the sweep
+float sweepHz(unsigned long elapsed)
+{
+	float position = elapsed >= SweepLength ? 1.0f : (float)elapsed / SweepLength;
+
+	if (SweepShape == SWEEP_EXPONENTIAL)
+	{
+		return SweepFrom * expf(SweepRatio * position);
+	}
+	return SweepFrom + (SweepTo - SweepFrom) * position;
+}
+
+unsigned int sweepTopOf(float hz)
+{
+	float top = F_CPU / (2.0f * OutputPrescalers[SweepPrescaler] * hz) - 0.5f;
+
+	if (top < SWEEP_MIN_TOP)
+	{
+		return SWEEP_MIN_TOP;
+	}
+	return top > 65535.0f ? 65535 : (unsigned int)top;
+}
+
+// at TOP, the value written now is picked up at a BOTTOM
+ISR(TIMER1_COMPA_vect)
+{
+	SweepElapsed += SweepLoaded + 1;
+	SweepLoaded = SweepTop;
+	OCR1A = SweepLoaded;
+}
+
+#endif /* SWEEP_H_ */
@@ -0,0 +1,163 @@
+/*
+ * uart.h
+ *
+ * Created: 10/21/2026 10:12:40 AM
+ *  Author: odinh
+ */
+
+
+#ifndef UART_H_
+#define UART_H_
+
+// interrupt driven USART0 on PD0 (RXD) and PD1 (TXD), both buffers must be a power of two so the indexes can
+// wrap with a mask
+#define UART_RX_BUFFER_SIZE 32
+#define UART_TX_BUFFER_SIZE 64
+
+volatile unsigned char UartRxBuffer[UART_RX_BUFFER_SIZE];
+volatile unsigned char UartRxHead;
+volatile unsigned char UartRxTail;
+volatile unsigned char UartTxBuffer[UART_TX_BUFFER_SIZE];
+volatile unsigned char UartTxHead;
+volatile unsigned char UartTxTail;
+
+// prototypes
+void uartInitialize(unsigned long baud);
+bool uartGetChar(char *c);
+void uartPutChar(char c);
+void uartPutString(const char *s);
+void uartPutString_P(const char *s);
+void uartPutLong(long value);
+void uartPutFixed(unsigned long value, unsigned char decimals);
+void uartPutNewLine(void);
+
+void uartInitialize(unsigned long baud)
+{
+	// double speed mode gives a usable divisor for 38400 baud at 8 MHz (0.2% error)
+	UBRR0 = (unsigned int)((F_CPU / (8UL * baud)) - 1);
+	UCSR0A = (1<<U2X0);
+	UCSR0C = (1<<UCSZ01) | (1<<UCSZ00); // 8N1
+	UartRxHead = UartRxTail = 0;
+	UartTxHead = UartTxTail = 0;
+	UCSR0B = (1<<RXEN0) | (1<<TXEN0) | (1<<RXCIE0);
+}
+
+bool uartGetChar(char *c)
+{
+	if (UartRxHead == UartRxTail)
+	{
+		return false;
+	}
+
+	*c = UartRxBuffer[UartRxTail];
+	UartRxTail = (UartRxTail + 1) & (UART_RX_BUFFER_SIZE - 1);
+	return true;
+}
+
+void uartPutChar(char c)
+{
+	unsigned char next = (UartTxHead + 1) & (UART_TX_BUFFER_SIZE - 1);
+
+	// wait for room in the buffer
+	while (next == UartTxTail);
+
+	UartTxBuffer[UartTxHead] = c;
+	UartTxHead = next;
+	UCSR0B |= (1<<UDRIE0);
+}
+
+void uartPutString(const char *s)
+{
+	while (*s)
+	{
+		uartPutChar(*s++);
+	}
+}
+
+void uartPutString_P(const char *s)
+{
+	char c;
+
+	while ((c = pgm_read_byte(s++)))
+	{
+		uartPutChar(c);
+	}
+}
+
+void uartPutLong(long value)
+{
+	char digits[11];
+	unsigned char length = 0;
+	unsigned long magnitude = value;
+
+	if (value < 0)
+	{
+		uartPutChar('-');
+		magnitude = 0UL - (unsigned long)value;
+	}
+
+	do
+	{
+		digits[length++] = '0' + (magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude > 0);
+
+	while (length > 0)
+	{
+		uartPutChar(digits[--length]);
+	}
+}
+
+// value scaled by 10^decimals, printed with the decimal point
+void uartPutFixed(unsigned long value, unsigned char decimals)
+{
+	unsigned long scale = 1;
+	unsigned char i;
+
+	for (i = 0; i < decimals; i++)
+	{
+		scale *= 10;
+	}
+	uartPutLong(value / scale);
+	if (decimals > 0)
+	{
+		uartPutChar('.');
+		for (scale /= 10; scale > 0; scale /= 10)
+		{
+			uartPutChar('0' + (value / scale) % 10);
+		}
+	}
+}
+
+void uartPutNewLine(void)
+{
+	uartPutChar('\r');
+	uartPutChar('\n');
+}
+
+ISR(USART_RX_vect)
+{
+	unsigned char c = UDR0;
+	unsigned char next = (UartRxHead + 1) & (UART_RX_BUFFER_SIZE - 1);
+
+	// drop the character if the shell has fallen behind
+	if (next != UartRxTail)
+	{
+		UartRxBuffer[UartRxHead] = c;
+		UartRxHead = next;
+	}
+}
+
+ISR(USART_UDRE_vect)
+{
+	if (UartTxHead == UartTxTail)
+	{
+		UCSR0B &= ~(1<<UDRIE0);
+		return;
+	}
+
+	UDR0 = UartTxBuffer[UartTxTail];
+	UartTxTail = (UartTxTail + 1) & (UART_TX_BUFFER_SIZE - 1);
+}
+
+#endif /* UART_H_ */
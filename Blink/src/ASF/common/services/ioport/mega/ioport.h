@@ -688,4 +688,64 @@ __always_inline static inline void ioport_tgl_group(port_id_t port_id,
 	arch_ioport_toggle_port_level(port_id, port_mask);
 }
 
+/*! \brief Drives a group of I/O pins of a port to mixed levels.
+ *
+ * The pins in \a port_mask take the level of the matching bit in \a values,
+ * the other pins of the port are left alone. The port is read once and
+ * written once, so the pins change together instead of one
+ * ioport_set_group_high() and one ioport_set_group_low() apart. The
+ * read-modify-write is not atomic, an interrupt that writes the same port
+ * has to be kept out by the caller.
+ *
+ * \param port_id The port number.
+ * \param port_mask The mask of the pins to drive.
+ * \param values The levels, bit n for pin n of the port.
+ */
+__always_inline static inline void ioport_write_group_masked(port_id_t port_id,
+		pin_mask_t port_mask, pin_mask_t values)
+{
+	PORT_t *base = arch_ioport_port_to_base(port_id);
+
+	base->PORTDATA = (base->PORTDATA & ~port_mask) | (values & port_mask);
+}
+
+#if defined(PORTB) && defined(PORTC) && defined(PORTD)
+/*! \brief Drives groups of I/O pins on PORTB, PORTC and PORTD to mixed levels.
+ *
+ * Each port is computed as in ioport_write_group_masked(), then the three
+ * ports are written by back to back out instructions: PORTC changes one
+ * cycle after PORTB and PORTD one cycle after PORTC, whatever the masks.
+ * A port with an empty mask is written back unchanged. Interrupts are off
+ * from the first read to the last write.
+ *
+ * \param mask_b The mask of the PORTB pins to drive.
+ * \param values_b The PORTB levels.
+ * \param mask_c The mask of the PORTC pins to drive.
+ * \param values_c The PORTC levels.
+ * \param mask_d The mask of the PORTD pins to drive.
+ * \param values_d The PORTD levels.
+ */
+__always_inline static inline void ioport_write_ports_masked(
+		pin_mask_t mask_b, pin_mask_t values_b,
+		pin_mask_t mask_c, pin_mask_t values_c,
+		pin_mask_t mask_d, pin_mask_t values_d)
+{
+	uint8_t flags = cpu_irq_save();
+	uint8_t b = (PORTB & ~mask_b) | (values_b & mask_b);
+	uint8_t c = (PORTC & ~mask_c) | (values_c & mask_c);
+	uint8_t d = (PORTD & ~mask_d) | (values_d & mask_d);
+
+	__asm__ __volatile__(
+		"out %[port_b], %[b]\n\t"
+		"out %[port_c], %[c]\n\t"
+		"out %[port_d], %[d]\n\t"
+		:
+		: [port_b] "I" (_SFR_IO_ADDR(PORTB)), [b] "r" (b),
+		  [port_c] "I" (_SFR_IO_ADDR(PORTC)), [c] "r" (c),
+		  [port_d] "I" (_SFR_IO_ADDR(PORTD)), [d] "r" (d)
+		: "memory");
+	cpu_irq_restore(flags);
+}
+#endif
+
 #endif /* IOPORT_MEGA_RF_H */
@@ -0,0 +1,137 @@
+/*
+ * adapt.h
+ *
+ * Created: 10/18/2026 6:10:55 PM
+ *  Author: odinh
+ */
+
+
+#ifndef ADAPT_H_
+#define ADAPT_H_
+
+// adaptive shift offsets.  Every shift tap on touch 1 captures the tach period at the moment it fires and the
+// number of gear changes seen so far on the gear change input (PD4, active low).  After a real run, every shift
+// that has a TargetRpm, was confirmed by a gear change and is not rpm triggered itself has its offset moved
+// towards the target - later when it fired below the target rpm, earlier when it fired above - by at most
+// CONF_ADAPT_MAX_STEP_MS per run.  The learned offsets are written back to the profile's EEPROM slot
+#define ADAPT_TOUCH 1
+#define ADAPT_MAX_SHIFTS 8
+
+#if CONF_ADAPT_ENABLED && !CONF_TACH_ENABLED
+#error "CONF_ADAPT_ENABLED tunes the shifts from the tach periods, it needs CONF_TACH_ENABLED"
+#endif
+
+struct Shift
+{
+	step Step;
+	unsigned long Period; // tach period when the tap fired (ticks)
+	unsigned char GearChanges; // gear changes seen before the tap fired
+};
+
+struct Shift AdaptShifts[ADAPT_MAX_SHIFTS];
+unsigned char AdaptShiftCount;
+volatile unsigned char GearChanges;
+
+// prototypes
+void initializeAdapt(void);
+void adaptStart(void);
+void adaptCapture(step step);
+void adaptRun(struct State *state);
+long adaptCorrection(unsigned int rpm, unsigned int target);
+
+void initializeAdapt(void)
+{
+	DDRD &= ~(1<<DDD4);
+	PORTD |= (1<<PIND4);
+	PCMSK2 |= (1<<PCINT20);
+	PCIFR = (1<<PCIF2);
+	PCICR |= (1<<PCIE2);
+}
+
+// called from startRun
+void adaptStart(void)
+{
+	AdaptShiftCount = 0;
+}
+
+// called from execute when a touch 1 step switches on
+void adaptCapture(step step)
+{
+	if (AdaptShiftCount < ADAPT_MAX_SHIFTS)
+	{
+		AdaptShifts[AdaptShiftCount].Step = step;
+		AdaptShifts[AdaptShiftCount].Period = getTachPeriod();
+		AdaptShifts[AdaptShiftCount].GearChanges = GearChanges;
+		AdaptShiftCount++;
+	}
+}
+
+// called from stopRun after a real run, the divisions are fine here
+void adaptRun(struct State *state)
+{
+	unsigned char i, confirmed;
+	struct Shift *shift;
+	bool isChanged = false;
+	long correction;
+
+	for (i = 0; i < AdaptShiftCount; i++)
+	{
+		shift = &AdaptShifts[i];
+
+		// the gear change that belongs to this tap has to arrive before the next tap fires
+		confirmed = (i + 1 < AdaptShiftCount) ? AdaptShifts[i + 1].GearChanges : GearChanges;
+		if (confirmed == shift->GearChanges || shift->Step->TargetRpm == 0 || shift->Step->Rpm > 0
+			|| shift->Period >= TACH_RPM_CONSTANT)
+		{
+			// missed shift, no target, rpm triggered or no tach - nothing to learn from
+			continue;
+		}
+
+		correction = adaptCorrection(TACH_RPM_CONSTANT / shift->Period, shift->Step->TargetRpm);
+		if (correction != 0 && (long)shift->Step->Offset + correction >= 0
+			&& shift->Step->Offset + shift->Step->Duration + correction <= STEP_MAX_US)
+		{
+			shift->Step->Offset += correction;
+			isChanged = true;
+		}
+	}
+
+	if (isChanged)
+	{
+		saveProfileSlot(state, state->Profile);
+	}
+}
+
+// microseconds to move a shift that fired at rpm instead of target
+long adaptCorrection(unsigned int rpm, unsigned int target)
+{
+	long error = (long)target - rpm;
+	long correction;
+
+	if (error > -CONF_ADAPT_DEADBAND_RPM && error < CONF_ADAPT_DEADBAND_RPM)
+	{
+		return 0;
+	}
+
+	correction = error * (CONF_ADAPT_MS_PER_100RPM * 1000L / 100);
+	if (correction > (long)MS(CONF_ADAPT_MAX_STEP_MS))
+	{
+		correction = (long)MS(CONF_ADAPT_MAX_STEP_MS);
+	}
+	else if (correction < -(long)MS(CONF_ADAPT_MAX_STEP_MS))
+	{
+		correction = -(long)MS(CONF_ADAPT_MAX_STEP_MS);
+	}
+	return correction;
+}
+
+ISR(PCINT2_vect)
+{
+	// count falling edges on the gear change input
+	if (!(PIND & (1<<PIND4)))
+	{
+		GearChanges++;
+	}
+}
+
+#endif /* ADAPT_H_ */
@@ -0,0 +1,157 @@
+/*
+ * adc.h
+ *
+ * Created: 10/18/2026 4:26:13 PM
+ *  Author: odinh
+ */
+
+
+#ifndef ADC_H_
+#define ADC_H_
+
+// free running ADC sampling for analog triggers (throttle position, boost pressure, ...).  The conversion
+// complete interrupt rotates through the inputs and queues every sample, adcPoll() drains the queue from
+// getUserInput() and runs each sample through the detectors of its input, so nothing ever waits on a conversion
+#define ADC_BUFFER_SIZE 16 // power of two
+#define ADC_INPUT_COUNT (sizeof(AdcChannels) / sizeof(AdcChannels[0]))
+
+struct Sample
+{
+	unsigned char Input; // index into AdcChannels
+	unsigned int Value;
+};
+
+// a detector switches on when its input crosses On and back off when it crosses Off.  With On above Off it
+// detects high readings, with On below Off it detects low readings, and On equal to Off is a plain threshold
+struct Detector
+{
+	unsigned char Input;
+	unsigned int On;
+	unsigned int Off;
+	bool IsOn;
+};
+
+const unsigned char AdcChannels[] = CONF_ADC_CHANNELS;
+
+volatile struct Sample AdcBuffer[ADC_BUFFER_SIZE];
+volatile unsigned char AdcHead;
+volatile unsigned char AdcTail;
+volatile unsigned char AdcDropped;
+unsigned char AdcConverting; // the input of the conversion in progress
+unsigned char AdcSelected; // the input ADMUX points at, used by the conversion after that
+unsigned int AdcLatest[ADC_INPUT_COUNT];
+
+// the detectors are defined in main.c
+extern struct Detector Detectors[];
+extern const unsigned char DetectorCount;
+
+// prototypes
+void initializeAdc(void);
+void adcPoll(void);
+void detect(struct Detector *detector, unsigned int value);
+bool isDetectorOn(unsigned char detector);
+
+void initializeAdc(void)
+{
+	unsigned char i;
+
+	for (i = 0; i < ADC_INPUT_COUNT; i++)
+	{
+		if (AdcChannels[i] < 6)
+		{
+			// ADC6 and ADC7 have no digital input buffer to disable
+			DIDR0 |= (1<<AdcChannels[i]);
+		}
+	}
+
+	AdcHead = AdcTail = 0;
+	AdcConverting = AdcSelected = 0;
+
+	ADMUX = (1<<REFS0) | AdcChannels[0]; // AVcc reference
+	ADCSRB = 0; // free running
+	// 8 MHz / 128 = 62.5 kHz ADC clock, about 4800 samples per second shared between the inputs
+	// a slower system clock gets a smaller ADC prescaler, see clock.h
+	ADCSRA = (1<<ADEN) | (1<<ADSC) | (1<<ADATE) | (1<<ADIE) | clockAdcPrescaler();
+}
+
+// called from getUserInput
+void adcPoll(void)
+{
+	struct Sample sample;
+	unsigned char d;
+
+	while (AdcTail != AdcHead)
+	{
+		sample.Input = AdcBuffer[AdcTail].Input;
+		sample.Value = AdcBuffer[AdcTail].Value;
+		AdcTail = (AdcTail + 1) & (ADC_BUFFER_SIZE - 1);
+
+		AdcLatest[sample.Input] = sample.Value;
+		for (d = 0; d < DetectorCount; d++)
+		{
+			if (Detectors[d].Input == sample.Input)
+			{
+				detect(&Detectors[d], sample.Value);
+			}
+		}
+	}
+}
+
+void detect(struct Detector *detector, unsigned int value)
+{
+	if (detector->On >= detector->Off)
+	{
+		if (!detector->IsOn && value >= detector->On)
+		{
+			detector->IsOn = true;
+		}
+		else if (detector->IsOn && value <= detector->Off)
+		{
+			detector->IsOn = false;
+		}
+	}
+	else
+	{
+		if (!detector->IsOn && value <= detector->On)
+		{
+			detector->IsOn = true;
+		}
+		else if (detector->IsOn && value >= detector->Off)
+		{
+			detector->IsOn = false;
+		}
+	}
+}
+
+bool isDetectorOn(unsigned char detector)
+{
+	return detector < DetectorCount && Detectors[detector].IsOn;
+}
+
+ISR(ADC_vect)
+{
+	unsigned int value = ADC;
+	unsigned char next = (AdcHead + 1) & (ADC_BUFFER_SIZE - 1);
+
+	if (next != AdcTail)
+	{
+		AdcBuffer[AdcHead].Input = AdcConverting;
+		AdcBuffer[AdcHead].Value = value;
+		AdcHead = next;
+	}
+	else
+	{
+		AdcDropped++;
+	}
+
+	// in free running mode the next conversion has already started on the selected input, so a mux change
+	// made now only applies to the conversion after that one
+	AdcConverting = AdcSelected;
+	if (++AdcSelected >= ADC_INPUT_COUNT)
+	{
+		AdcSelected = 0;
+	}
+	ADMUX = (1<<REFS0) | AdcChannels[AdcSelected];
+}
+
+#endif /* ADC_H_ */
@@ -0,0 +1,130 @@
+/*
+ * bench.h
+ *
+ * Created: 10/19/2026 7:40:12 PM
+ *  Author: odinh
+ */
+
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+// press to edge benchmark.  Every real run measures, for each touch output, the time from the start button
+// press interrupt to the first rising edge on its touch port pin, less the time the schedule asked for - for the
+// zero offset start pedal touch that is the latency the driver feels, for the first shift it is how late the
+// paddle fires.  Timer1 runs at full speed during a run, so the ticks are CPU cycles (reference cycles with
+// CONF_TIMEBASE_EXTERNAL).  The interrupt entry itself (about 10 cycles, more from sleep) comes before the stamp
+// and is not included.  The same numbers can be read from State.Stats in the simulator with a stimulus on PB0.
+// BENCH_CONFIG names the build being measured
+#define BENCH_TOUCH_MASK (((1 << PINS_TOUCH_COUNT) - 1) & ~WAVE_MASK) // wave outputs are not on the touch port
+
+#if CONF_START_INTERRUPT
+#define BENCH_CONFIG_START "interrupt"
+#else
+#define BENCH_CONFIG_START "poll"
+#endif
+#if CONF_FIXED_POINT_TIME
+#define BENCH_CONFIG_TIME " fixed"
+#else
+#define BENCH_CONFIG_TIME " double"
+#endif
+#if CONF_TICK_ENABLED
+#define BENCH_CONFIG_LOOP " tick"
+#else
+#define BENCH_CONFIG_LOOP " loop"
+#endif
+#if CONF_TIMEBASE_EXTERNAL
+#define BENCH_CONFIG_TIMEBASE " t1"
+#else
+#define BENCH_CONFIG_TIMEBASE ""
+#endif
+#define BENCH_CONFIG BENCH_CONFIG_START BENCH_CONFIG_TIME BENCH_CONFIG_LOOP BENCH_CONFIG_TIMEBASE
+
+unsigned long BenchPress; // press stamp of the current run
+unsigned char BenchPending; // touch outputs that have not had their first edge in the current run
+
+// prototypes
+void initializeBench(void);
+void benchStart(struct State *state);
+void benchEdge(struct State *state);
+void benchRecord(struct State *state, int s, unsigned long ticks);
+
+void initializeBench(void)
+{
+	// the press and edge stamps are Timer1 extended by the overflow count, tach, clock and power may all be off
+	TIMSK1 |= (1<<TOIE1);
+}
+
+// called from startRun
+void benchStart(struct State *state)
+{
+	unsigned char fired, s;
+	irqflags_t flags;
+
+	if (state->IsDryRun)
+	{
+		BenchPending = 0;
+		return;
+	}
+
+	flags = cpu_irq_save();
+	BenchPress = PressStamp;
+	fired = PressFired;
+	PressFired = 0;
+	cpu_irq_restore(flags);
+
+	BenchPending = BENCH_TOUCH_MASK;
+#if CONF_POWER_ENABLED
+	state->Stats.IsLastWakeFromPowerDown = IsPoweredDown;
+	IsPoweredDown = false;
+#endif
+
+	// outputs the press interrupt switched on had their edge right before the stamp
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		if (fired & (1<<s))
+		{
+			benchRecord(state, s, 0);
+		}
+	}
+}
+
+// called from setOutputs after the touch outputs are written
+void benchEdge(struct State *state)
+{
+	unsigned char edges = pinsTouchLatched() & BenchPending;
+	unsigned long ticks;
+	irqflags_t flags;
+	int s;
+
+	if (edges == 0 || !state->IsRunning)
+	{
+		return;
+	}
+
+	flags = cpu_irq_save();
+	ticks = getTimer1Stamp() - BenchPress;
+	cpu_irq_restore(flags);
+
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		if (edges & (1<<s))
+		{
+			benchRecord(state, s, ticks);
+		}
+	}
+}
+
+void benchRecord(struct State *state, int s, unsigned long ticks)
+{
+	long late = (long)ticks - (long)(state->Start_Touch[s] * TICKS_PER_US);
+
+	BenchPending &= ~(1<<s);
+	state->Stats.EdgeLateTicks[s] = late;
+	if (late > state->Stats.MaxEdgeLateTicks[s])
+	{
+		state->Stats.MaxEdgeLateTicks[s] = late;
+	}
+}
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,100 @@
+/*
+ * clock.h
+ *
+ * Created: 10/19/2026 1:14:37 PM
+ *  Author: odinh
+ */
+
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+// system clock scaling.  While nothing is pressed, running or recording the system clock is divided down by
+// CLKPR (2^CONF_CLOCK_IDLE_PRESCALER) and it goes back to full speed as soon as the start button is seen.
+// Timer1 and Timer2 run from the scaled clock, so every clock change is a new clock domain: getTimer1Stamp()
+// and state->Ticks are kept in full speed ticks (F_CPU) across the change and everything built on them - step
+// times, tach periods, wake stamps - stays valid.  Raw TCNT1 readings (record.h) are only used at full speed
+#if CONF_SHELL_ENABLED
+#define CLOCK_IDLE_PRESCALER 0 // the USART baud rate follows the system clock
+#elif CONF_TIMEBASE_EXTERNAL
+#define CLOCK_IDLE_PRESCALER 0 // T1 is sampled on the system clock, which has to stay 2.5 times faster
+#else
+#define CLOCK_IDLE_PRESCALER CONF_CLOCK_IDLE_PRESCALER
+#endif
+
+#if CLOCK_IDLE_PRESCALER > 8
+#error "CONF_CLOCK_IDLE_PRESCALER is a CLKPR setting, 0 (/1) to 8 (/256)"
+#endif
+
+unsigned char ClockShift; // the current CLKPR setting, a Timer1 count is worth 2^ClockShift full speed ticks
+unsigned long ClockBase; // full speed stamp at the last clock change
+unsigned long ClockRawBase; // raw Timer1 count at the last clock change
+
+// prototypes
+void initializeClock(void);
+void clockUpdate(struct State *state);
+void clockSet(struct State *state, unsigned char shift);
+unsigned long clockNormalize(unsigned long raw);
+unsigned char clockAdcPrescaler(void);
+
+void initializeClock(void)
+{
+	ClockShift = 0;
+	ClockBase = ClockRawBase = 0;
+	// the 32-bit Timer1 count has to keep going while the clock is slow
+	TIMSK1 |= (1<<TOIE1);
+}
+
+// called from getUserInput once the start button has been read
+void clockUpdate(struct State *state)
+{
+	unsigned char shift = CLOCK_IDLE_PRESCALER;
+
+	if (state->IsPressed_StartButton || state->IsRunning || state->IsRecording)
+	{
+		shift = 0;
+	}
+
+	if (shift != ClockShift)
+	{
+		clockSet(state, shift);
+	}
+}
+
+void clockSet(struct State *state, unsigned char shift)
+{
+	irqflags_t flags;
+	unsigned long raw;
+
+	// close out the old domain first so the ticks up to here are counted at the old rate
+	getClockTime(state);
+
+	flags = cpu_irq_save();
+	raw = getTimer1Count();
+	ClockBase = clockNormalize(raw);
+	ClockRawBase = raw;
+	ClockShift = shift;
+	clock_prescale_set((clock_div_t)shift);
+#if CONF_ADC_ENABLED
+	// keep the ADC clock near 62.5 kHz, ADIF is left alone so a finished conversion still interrupts
+	ADCSRA = (ADCSRA & ~((1<<ADIF) | (1<<ADPS2) | (1<<ADPS1) | (1<<ADPS0))) | clockAdcPrescaler();
+#endif
+	cpu_irq_restore(flags);
+
+	state->ClockPrescaler = shift;
+	state->ClockSpeed = F_CPU >> shift;
+}
+
+// raw Timer1 count to full speed ticks, call with interrupts disabled
+unsigned long clockNormalize(unsigned long raw)
+{
+	return ClockBase + ((raw - ClockRawBase) << ClockShift);
+}
+
+// ADPS bits for an ADC clock of F_CPU / 128 at the current system clock
+unsigned char clockAdcPrescaler(void)
+{
+	return ClockShift < 6 ? 7 - ClockShift : 1;
+}
+
+#endif /* CLOCK_H_ */
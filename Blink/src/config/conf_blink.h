@@ -0,0 +1,94 @@
+/*
+ * conf_blink.h
+ *
+ * Created: 10/18/2026 9:12:04 AM
+ *  Author: odinh
+ */
+
+
+#ifndef CONF_BLINK_H_
+#define CONF_BLINK_H_
+
+// UART tuning shell
+// USART0 uses PD0 (RXD) and PD1 (TXD), which are also touch 0 and touch 1.  The shell only owns the
+// USART while the sequencer is idle and hands the pins back to the touch outputs for a real run, but
+// while idle TXD holds PD1 high - only enable the shell on the bench with the touch outputs disconnected
+#define CONF_SHELL_ENABLED 0
+#define CONF_UART_BAUD 38400
+
+// record mode, entered from the shell or by holding the start button at power up
+// PC0, PC1 and PC2 are the record inputs for touch 0, 1 and 2 (active low, internal pull-ups)
+#define CONF_RECORD_ENABLED 1
+
+// tach input on INT1 (PD3) for rpm triggered shift steps
+#define CONF_TACH_ENABLED 1
+#define CONF_TACH_PULSES_PER_REV 1
+#define CONF_TACH_MAX_RPM 12000
+
+// free running ADC for analog triggers.  ADC6 and ADC7 are analog only pins on the TQFP/QFN packages, so
+// they do not collide with the record inputs on PC0 - PC2
+#define CONF_ADC_ENABLED 1
+#define CONF_ADC_CHANNELS { 6, 7 } // throttle position, boost pressure
+
+// adaptive shift offsets from the tach (needs CONF_TACH_ENABLED) and the gear change input on PD4
+#define CONF_ADAPT_ENABLED 1
+#define CONF_ADAPT_MS_PER_100RPM 10 // how far to move a shift for every 100 rpm it missed its target by
+#define CONF_ADAPT_MAX_STEP_MS 8 // the most a shift can move after a single run
+#define CONF_ADAPT_DEADBAND_RPM 50
+
+// convert TCNT1 ticks into DeltaTime with integer math instead of double
+#define CONF_FIXED_POINT_TIME 1
+
+// time triggered main loop - Timer2 compare match paces run() every CONF_TICK_US (at most 255 us) and the CPU
+// idles in between.  Needs CONF_FIXED_POINT_TIME, the double conversion alone does not fit in a 100 us tick
+#define CONF_TICK_ENABLED 0
+#define CONF_TICK_US 100
+
+// idle sleep between button events, power-down after a while without one (only when the shell is off)
+#define CONF_POWER_ENABLED 1
+#define CONF_POWER_DOWN_AFTER_S 60
+
+// divide the system clock by 2^CONF_CLOCK_IDLE_PRESCALER (CLKPR) while waiting for the start button,
+// full speed while pressed, running or recording.  Not used when the shell is enabled
+#define CONF_CLOCK_ENABLED 1
+#define CONF_CLOCK_IDLE_PRESCALER 3
+
+// internal RC oscillator calibration, one OSCCAL value per temperature band (internal sensor) kept in EEPROM
+// CONF_OSCCAL_CRYSTAL 1 - 32.768 kHz watch crystal on TOSC1/TOSC2 (PB6/PB7), calibrates at power up in a new band
+// CONF_OSCCAL_CRYSTAL 0 - a stream of 'U' characters on RXD at CONF_UART_BAUD, calibrates from the shell (cal)
+#define CONF_OSCCAL_ENABLED 1
+#define CONF_OSCCAL_CRYSTAL 0
+#define CONF_OSCCAL_CHECK_S 30 // how often the temperature is checked while idle
+
+// actuator latency trims - every step of a touch output fires this much earlier (ms).  These are the channel
+// defaults until they are changed from the shell (trim), a profile can carry its own (ptrim)
+#define CONF_TRIM_ENABLED 1
+#define CONF_TRIM_DEFAULTS { 0, 0, 0 } // start pedal, shift paddle, NO2 button
+
+// start the run from the start button pin change interrupt as well as the poll - outputs with a step at zero
+// switch on inside the interrupt
+#define CONF_START_INTERRUPT 0
+
+// measure press to first edge latency on every run, see bench.h
+#define CONF_BENCH_ENABLED 1
+
+// drive touch outputs from the timer compare outputs instead of PORTD, see wave.h.  Each touch is WAVE_NONE
+// (PORTD as before) or one of WAVE_OC0A (PD6), WAVE_OC0B (PD5), WAVE_OC1A (PB1), WAVE_OC1B (PB2), WAVE_OC2B (PD3)
+#define CONF_WAVE_ENABLED 0
+#define CONF_WAVE_TOUCH0 WAVE_OC0A // start pedal
+#define CONF_WAVE_TOUCH1 WAVE_OC0B // shift paddle
+#define CONF_WAVE_TOUCH2 WAVE_NONE // NO2 button
+
+// hardware watchdog fed from main loop progress, outputs forced off on a hang and the reset cause logged to
+// EEPROM, see watchdog.h.  The run timeout applies while the touch outputs can be on
+#define CONF_WATCHDOG_ENABLED 1
+#define CONF_WATCHDOG_RUN_TIMEOUT WDTO_30MS
+#define CONF_WATCHDOG_IDLE_TIMEOUT WDTO_2S
+
+// clock Timer1 from a reference on T1 (PD5) instead of the system clock - a TCXO or the 8mhzOut board - for
+// crystal grade step timing with the CPU still on the RC oscillator.  CONF_TIMEBASE_HZ is the reference, whole
+// MHz and below F_CPU / 2.5.  Idle clock scaling is off with it and wave outputs can only use Timer1
+#define CONF_TIMEBASE_EXTERNAL 0
+#define CONF_TIMEBASE_HZ 2000000UL
+
+#endif /* CONF_BLINK_H_ */
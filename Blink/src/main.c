@@ -1,56 +1,168 @@
+#define F_CPU 8000000UL // must be defined before util/delay.h, which otherwise assumes 1 MHz
+
 #include <asf.h>
 #include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/power.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
 #include <util/delay.h>
 #include <stdio.h>
+#include <string.h>
+#include <conf_blink.h>
+#include <pins.h>
 #include <main.h>
-
-#define F_CPU 8000000
-
+#include <clock.h>
+#include <tach.h>
+#include <adc.h>
+#include <tick.h>
+#include <wave.h>
+#include <watchdog.h>
+#include <press.h>
+#include <power.h>
+#include <bench.h>
+#include <osccal.h>
+#include <trim.h>
+#include <uart.h>
+#include <profile.h>
+#include <adapt.h>
+#include <shell.h>
+#include <record.h>
 
 // various stored sequences
 void initialize1sBlinkSequence(struct State *state);
 void initializeHuracanPSSequence(struct State *state);
 
+const char Blink1sName[] PROGMEM = "1s blink";
+const char HuracanPSName[] PROGMEM = "huracan ps";
+
+// built-in profiles, each one owns the EEPROM slot with the same index (see profile.h)
+const struct Profile Profiles[] =
+{
+	{ Blink1sName, initialize1sBlinkSequence },
+	{ HuracanPSName, initializeHuracanPSSequence },
+};
+const unsigned char BuiltinProfileCount = sizeof(Profiles) / sizeof(Profiles[0]);
+const unsigned char DefaultProfile = 1;
+#if PINS_TOUCH_COUNT < 3
+#error "the built-in profiles drive touches 0 to 2"
+#endif
+
+// analog detectors, steps refer to them by number starting at 1 (see createTriggeredTap)
+struct Detector Detectors[] =
+{
+	{ 0, 800, 760, false }, // throttle past ~78%, released below ~74%
+	{ 1, 600, 580, false }, // boost pressure
+};
+const unsigned char DetectorCount = sizeof(Detectors) / sizeof(Detectors[0]);
+
 
 int main (void)
 {
-	struct State *state = initialize(0, 8000000);
+	struct State *state;
+
+#if CONF_TRIM_ENABLED
+	// before initialize() loads the profile, armRun() bakes the trims into the schedule of the first run
+	initializeTrim();
+#endif
+	state = initialize(0, 8000000);
+
+#if CONF_POWER_ENABLED
+	initializePower();
+#endif
+#if PRESS_ENABLED
+	initializePress();
+#endif
+#if CONF_BENCH_ENABLED
+	initializeBench();
+#endif
+#if CONF_CLOCK_ENABLED
+	initializeClock();
+#endif
+#if CONF_OSCCAL_ENABLED
+	// before anything that depends on the clock rate, the USART baud rate included
+	initializeOsccal();
+#endif
+#if CONF_SHELL_ENABLED
+	shellInitialize();
+#endif
+#if CONF_RECORD_ENABLED
+	// holding the start button while powering up enters record mode
+	_delay_ms(10);
+	if (pinsIsStartPressed())
+	{
+		startRecording(state);
+	}
+#endif
+#if CONF_TACH_ENABLED
+	initializeTach();
+#endif
+#if CONF_ADC_ENABLED
+	initializeAdc();
+#endif
+#if CONF_ADAPT_ENABLED
+	initializeAdapt();
+#endif
+#if CONF_TICK_ENABLED
+	initializeTick();
+#endif
+#if CONF_WAVE_ENABLED
+	initializeWave();
+#endif
+#if CONF_WATCHDOG_ENABLED
+	initializeWatchdog();
+#endif
+	sei();
 	
 	while(true)
 	{
+#if CONF_TICK_ENABLED
+		waitForTick();
 		run(state);
+		measureTick(state);
+#else
+		run(state);
+#endif
+#if CONF_WATCHDOG_ENABLED
+		watchdogFeed(state);
+#endif
+#if CONF_POWER_ENABLED
+		sleepWhileIdle(state);
+#endif
 	}
 }
 
 // called from initialize
 void initializeControlRegisters(void)
 {
-	// Configure the LED port PB
-	DDRB |= (1<<DDB1);
-	DDRB |= (1<<DDB2);
-	DDRD |= (1<<DDD0); // touch 0
-	DDRD |= (1<<DDD1); // touch 1
-	DDRD |= (1<<DDD2); // touch 2
-	//DDRD &= ~(1<<DDD0); // set as input
-	DDRB &= ~(1<<DDB0); // set as input
-
-	// enable 16-bit timer, no prescaling
-	TCCR1B = 1;
-
-	//PORTD = 0;
-	//PORTD |= 1 << PIND0;
-	PORTB |= 1 << PINB0;
+	// LEDs and touch outputs, the start button as an input (pins.h)
+	initializePins();
+
+	// enable 16-bit timer, no prescaling or counting the external reference on T1
+#if CONF_TIMEBASE_EXTERNAL
+	DDRD &= ~(1<<DDD5);
+	PORTD &= ~(1<<PIND5);
+#endif
+	TCCR1B = TIMEBASE_CS;
 }
 //called from initialize
 void initializeTapSequences(struct State *state)
 {
-	//initialize1sBlinkSequence(state);
-	initializeHuracanPSSequence(state);
+	int s;
+
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		state->TouchDefault[s] = NULL;
+		state->Schedule_Touch[s] = NULL;
+	}
+	loadProfile(state, readActiveProfile());
 }
 // called from run
 void getUserInput(struct State *state)
 {
-	if ((PINB & 1) == 0)
+	if (pinsIsStartPressed())
 	{
 		state->IsPressed_StartButton = true;
 	}
@@ -58,26 +170,51 @@ void getUserInput(struct State *state)
 	{
 		state->IsPressed_StartButton = false;
 	}
+#if CONF_START_INTERRUPT
+	if (IsPressPending)
+	{
+		// a press too short for the poll still counts
+		IsPressPending = false;
+		state->IsPressed_StartButton = true;
+	}
+#endif
+
+#if CONF_ADC_ENABLED
+	adcPoll();
+#endif
+#if CONF_CLOCK_ENABLED
+	// full speed before a press gets to execute
+	clockUpdate(state);
+#endif
 }
 // called from run
 void execute(struct State *state)
 {
 	int s = 0;
 	step step;
+	unsigned long next;
+
+	if (state->IsRecording)
+	{
+		record(state);
+		return;
+	}
 
 	if (!(state->IsRunning))
 	{
 		if (state->IsPressed_StartButton)
 		{
 			// we need to start the sequence
-			state->IsRunning = true;
-			// we need to reset our sequence steps to the beginning
-			resetTouchSteps(state);
-			// reset our start timer
-			setStartTime(state);
+			startRun(state);
 		}
 	}
 	
+	if (state->IsRunning && state->DeltaTime < state->NextEventUS)
+	{
+		// nothing can switch before the next event, so most passes cost a single compare
+		return;
+	}
+
 	if (state->IsRunning)
 	{
 		// we need to run the sequence
@@ -88,12 +225,22 @@ void execute(struct State *state)
 
 		// now loop over the items in our Touch array
 
-		for(s = 0; s < 3; s++)
+		state->NextEventUS = 0xFFFFFFFFUL;
+		for(s = 0; s < PINS_TOUCH_COUNT; s++)
 		{
 			step = state->Touch[s];
 
+			// rpm and analog steps start early once their condition is met
+			if (!state->IsTriggered_Touch[s] && !state->IsComplete_Touch[s]
+				&& state->DeltaTime < state->Start_Touch[s] && isStepTriggered(state, s, step))
+			{
+				state->Start_Touch[s] = state->DeltaTime;
+				state->End_Touch[s] = state->DeltaTime + step->Duration;
+				state->IsTriggered_Touch[s] = true;
+			}
+
 			// first check to see if the current time has moved beyond the current step
-			while(!state->IsComplete_Touch[s] && state->DeltaTimeMS > step->Offset + step->Duration)
+			while(!state->IsComplete_Touch[s] && state->DeltaTime > state->End_Touch[s])
 			{
 				// assign the current step to the child step, if a child exists
 				
@@ -104,17 +251,27 @@ void execute(struct State *state)
 				else
 				{
 					step = step->Next;
+					state->Touch[s] = step;
+					state->Index_Touch[s]++;
+					beginStep(state, s);
 				}
 			}
 
 			if (!state->IsComplete_Touch[s]) // the sequence isn't finished yet
 			{
 				// lets see if this step is ready to execute
-				if (step->Offset <= state->DeltaTimeMS && step->Offset + step->Duration >= state->DeltaTimeMS)
+				if (state->Start_Touch[s] <= state->DeltaTime && state->End_Touch[s] >= state->DeltaTime)
 				{
 					// lets check that the duration is greater than zero.  Zero duration steps are simply placeholders
 					if (step->Duration > 0)
 					{
+#if CONF_ADAPT_ENABLED
+						if (s == ADAPT_TOUCH && !state->IsActive_Touch[s] && !state->IsDryRun)
+						{
+							// a shift is about to fire, remember the rpm it fired at
+							adaptCapture(step);
+						}
+#endif
 						// ok, we need to execute this step by activating the touch signal
 						state->IsActive_Touch[s] = true;
 					}
@@ -124,7 +281,7 @@ void execute(struct State *state)
 					state->IsActive_Touch[s] = false;
 				}
 
-				if (step->Offset + step->Duration < state->DeltaTimeMS && step->Next == NULL)
+				if (state->End_Touch[s] < state->DeltaTime && step->Next == NULL)
 				{
 					// the sequence is complete
 					state->IsComplete_Touch[s] = true;
@@ -135,11 +292,27 @@ void execute(struct State *state)
 				// make sure the active state is switched off is the sequence is complete
 				state->IsActive_Touch[s] = false;
 			}
+
+			if (!state->IsComplete_Touch[s])
+			{
+				// when this touch changes next - at the start of its step, just past the end, or on every pass
+				// while an rpm or analog trigger can still pull the start in
+				next = state->DeltaTime < state->Start_Touch[s] ? state->Start_Touch[s] : state->End_Touch[s] + 1;
+				if (!state->IsTriggered_Touch[s] && (step->Rpm > 0 || step->Detector > 0)
+					&& state->DeltaTime < state->Start_Touch[s])
+				{
+					next = 0;
+				}
+				if (next < state->NextEventUS)
+				{
+					state->NextEventUS = next;
+				}
+			}
 		}
 
 		// now check to see if all sequences are finished
 		bool isComplete = true;
-		for(s = 0; s < 3; s++)
+		for(s = 0; s < PINS_TOUCH_COUNT; s++)
 		{
 			if (!state->IsComplete_Touch[s])
 			{
@@ -151,58 +324,162 @@ void execute(struct State *state)
 		if (isComplete)
 		{
 			// all the sequences are finished, so take us out of run mode
-			state->IsRunning = false;
-			resetTouchSteps(state);
+			stopRun(state);
 		}
 	}
 }
-// called from run
-void setOutputs(struct State *state)
+// called from execute
+bool isStepTriggered(struct State *state, int s, step step)
 {
-	if (state->IsRunning)
+#if CONF_TACH_ENABLED
+	unsigned long period;
+
+	if (step->Rpm > 0)
 	{
-		// toggle the red and green LED pins to show green and hide red
-		PORTB &= ~(1<<PINB2);
-		PORTB |= (1<<PINB1);
+		// the tach period drops to the period at the rpm of the step.  The step becomes current as the shift before
+		// it ends, still above its rpm, so it only fires once the rpm has come back down in the next gear
+		period = getTachPeriod();
+		if (period > state->TriggerPeriod_Touch[s] + (state->TriggerPeriod_Touch[s] >> TACH_REARM_SHIFT))
+		{
+			state->IsRpmArmed_Touch[s] = true;
+		}
+		else if (state->IsRpmArmed_Touch[s] && period <= state->TriggerPeriod_Touch[s])
+		{
+			return true;
+		}
 	}
-	else
+#endif
+#if CONF_ADC_ENABLED
+	if (step->Detector > 0)
 	{
-		// toggle the red and green LED pins to show red and hide green
-		PORTB |= (1<<PINB2);
-		PORTB &= ~(1<<PINB1);
+		// an off to on edge, a detector still on from the step before does not fire this one
+		if (!isDetectorOn(step->Detector - 1))
+		{
+			state->IsDetectorArmed_Touch[s] = true;
+		}
+		else if (state->IsDetectorArmed_Touch[s])
+		{
+			return true;
+		}
+	}
+#endif
+	return false;
+}
+// called from execute and the shell
+void startRun(struct State *state)
+{
+	if (!state->IsArmed)
+	{
+		// only when a run is started in the same pass that changed the steps
+		armRun(state);
 	}
 
-
-	// activate the output ports based on the IsActive_Touch state
-	// touch 0
-	if (state->IsActive_Touch[0])
+	// the steps were reset when the sequencer was armed, all that is left is to reset our start timer
+	setStartTime(state);
+	state->IsRunning = true;
+	state->IsArmed = false;
+#if CONF_START_INTERRUPT
+	setPressOutputs(0);
+#endif
+	state->Stats.RunCount++;
+#if CONF_WAVE_ENABLED
+	waveStart(state);
+#endif
+#if CONF_BENCH_ENABLED
+	benchStart(state);
+#endif
+
+#if CONF_SHELL_ENABLED
+	if (!state->IsDryRun)
 	{
-		PORTD |= (1<<PIND0);
+		// PD0 and PD1 are touch 0 and touch 1 for a real run
+		uartDetach();
 	}
-	else
+#endif
+}
+// called from execute
+void stopRun(struct State *state)
+{
+	state->IsRunning = false;
+	state->Stats.LastRunMS = state->DeltaTimeMS;
+#if CONF_WAVE_ENABLED
+	waveStop();
+#endif
+#if CONF_WATCHDOG_ENABLED
+	watchdogIdle();
+#endif
+#if CONF_ADAPT_ENABLED
+	if (!state->IsDryRun)
 	{
-		PORTD &= ~(1<<PIND0);
+		adaptRun(state);
 	}
+#endif
+	// get ready for the next press, with anything adaptRun() just learned
+	armRun(state);
 
-	// touch 1
-	if (state->IsActive_Touch[1])
+#if CONF_SHELL_ENABLED
+	if (state->IsDryRun)
 	{
-		PORTD |= (1<<PIND1);
+		uartPutString_P(PSTR("done\r\n"));
+		shellPrompt();
 	}
 	else
 	{
-		PORTD &= ~(1<<PIND1);
+		setOutputs(state);
+		uartAttach();
+	}
+#endif
+	state->IsDryRun = false;
+}
+// called from run while idle
+void runBackground(struct State *state)
+{
+	if (!state->IsArmed)
+	{
+		armRun(state);
 	}
+#if CONF_OSCCAL_ENABLED
+	osccalPoll();
+#endif
+#if CONF_SHELL_ENABLED
+	shellPoll(state);
+#endif
+}
+// called from run
+void setOutputs(struct State *state)
+{
+	unsigned char touches = 0;
+	irqflags_t flags;
 
-	// touch 2
-	if (state->IsActive_Touch[2])
+	// show both red and green while recording, green while running and red otherwise.  An LED pin that is a
+	// wave output belongs to the timer
+	if (!WAVE_OWNS(PIN_LED_RED))
 	{
-		PORTD |= (1<<PIND2);
+		ioport_set_pin_level(PIN_LED_RED, state->IsRecording || !state->IsRunning);
 	}
-	else
+	if (!WAVE_OWNS(PIN_LED_GREEN))
+	{
+		ioport_set_pin_level(PIN_LED_GREEN, state->IsRecording || state->IsRunning);
+	}
+
+
+	// activate the output ports based on the IsActive_Touch state, a dry run leaves them all off.  Wave outputs
+	// are left to the timer.  All touches are written at once, a step that hands over from one touch to another
+	// never has both or neither on, with interrupts off so the press interrupt can not be undone halfway through
+	if (!state->IsDryRun)
 	{
-		PORTD &= ~(1<<PIND2);
+		touches = PINS_TOUCH_ACTIVE(state);
 	}
+	flags = cpu_irq_save();
+	ioport_write_group_masked(PINS_TOUCH_PORT, PINS_TOUCH_BITS(~WAVE_MASK), touches);
+	cpu_irq_restore(flags);
+
+#if CONF_WAVE_ENABLED
+	waveUpdate(state);
+#endif
+#if CONF_BENCH_ENABLED
+	benchEdge(state);
+#endif
 	 
 	 // touch 3
 	//if (state->IsActive_Touch[3])
@@ -223,43 +500,43 @@ void initialize1sBlinkSequence(struct State *state)
 {
 	step current, tmp;
 	// sequence 0 is the start pedal, sequence 1 is the shift paddle and sequence 2 is the N02 button
-	tmp = createTap(1000);
+	tmp = createTap(MS(1000));
 	current = tmp;// start immediately after the start button is pressed, remain pressed for 3.455 seconds
 	state->TouchDefault[0] = current;
 
-	tmp = createTap(2000);
+	tmp = createTap(MS(2000));
 	current->Next = tmp;
 	current = current->Next;
 
-	tmp = createTap(3000);
+	tmp = createTap(MS(3000));
 	current->Next = tmp;
 	current = current->Next;
 
-	tmp = createTap(4000);
+	tmp = createTap(MS(4000));
 	current->Next = tmp;
 	current = current->Next;
 
-	tmp = createTap(5000);
+	tmp = createTap(MS(5000));
 	current->Next = tmp;
 	current = current->Next;
 
-	tmp = createTap(6000);
+	tmp = createTap(MS(6000));
 	current->Next = tmp;
 	current = current->Next;
 
-	tmp = createTap(7000);
+	tmp = createTap(MS(7000));
 	current->Next = tmp;
 	current = current->Next;
 
-	tmp = createTap(8000);
+	tmp = createTap(MS(8000));
 	current->Next = tmp;
 	current = current->Next;
 
-	tmp = createTap(9000);
+	tmp = createTap(MS(9000));
 	current->Next = tmp;
 	current = current->Next;
 
-	tmp = createTap(10000);
+	tmp = createTap(MS(10000));
 	current->Next = tmp;
 }
 
@@ -267,42 +544,42 @@ void initialize1sBlinkSequence(struct State *state)
 void initializeHuracanPSSequence(struct State *state)
 {
 	step current, tmp;
-	int startHold = 3400;
-	int startWait = 500;
-	int startOffset = startHold + startWait;
+	unsigned long startHold = 3400;
+	unsigned long startWait = 500;
+	unsigned long startOffset = startHold + startWait; // milliseconds
 	// sequence 0 is the start pedal, sequence 1 is the shift paddle and sequence 2 is the N02 button
-	tmp = createTouch(0, startHold);
+	tmp = createTouch(0, MS(startHold));
 	current = tmp;// start immediately after the start button is pressed, remain pressed for 3.455 seconds
 	state->TouchDefault[0] = current;
 
 	// now there is a gap of time to allow the needle to fall to start position
 
 	// now there is a short delay before shifting to second gear, which is the first activation for sequence 1
-	tmp = createTap(startOffset + 400); // shift to 2nd gear **NOTE** NO2 and Shift offsets are relative to start button as well
+	tmp = createTap(MS(startOffset + 400)); // shift to 2nd gear **NOTE** NO2 and Shift offsets are relative to start button as well
 	current = tmp;
 	state->TouchDefault[1] = current;
 	// shift to 3rd gear
-	tmp = createTap(startOffset + 1472); //1467
+	tmp = createTap(MS(startOffset + 1472)); //1467
 	current->Next = tmp;
 	current = current->Next;
 	// shift to 4th gear
-	tmp = createTap(startOffset + 1646); //1633
+	tmp = createTap(MS(startOffset + 1646)); //1633
 	current->Next = tmp;
 	current = current->Next;
 	// shift to 5th gear
-	tmp = createTap(startOffset + 2900); //2867
+	tmp = createTap(MS(startOffset + 2900)); //2867
 	current->Next = tmp;
 	current = current->Next;
 	// shift to 6th gear
-	tmp = createTap(startOffset + 4000); //3967
+	tmp = createTap(MS(startOffset + 4000)); //3967
 	current->Next = tmp;
 	current = current->Next;
 	// shift to 7th gear
-	tmp = createTap(startOffset + 4433); //4450
+	tmp = createTap(MS(startOffset + 4433)); //4450
 	current->Next = tmp;
 	current = current->Next;
 	
-	tmp = createTap(startOffset + 1733); // 1733 hit N02 at the same time we shift to 4th
+	tmp = createTap(MS(startOffset + 1733)); // 1733 hit N02 at the same time we shift to 4th
 	current = tmp;
 	state->TouchDefault[2] = current;
 }
@@ -5,31 +5,91 @@
  *  Author: odinh
  */ 
 
+ // step times are microseconds from the press on a 32-bit timeline (71 minutes)
+ #define MS(ms) ((ms) * 1000UL)
+ #define STEP_MAX_US 0x7FFFFFFFUL // keeps Offset + Duration and signed adjustments in range
+
  struct Step
  {
-	 int Offset;
-	 int Duration;
+	 unsigned long Offset; // microseconds after the press
+	 unsigned long Duration; // microseconds
+	 unsigned int Rpm; // when non-zero the step starts at this rpm, or at Offset if the rpm is never reached
+	 unsigned char Detector; // when non-zero the step starts when analog detector (Detector - 1) switches on, or at Offset
+	 unsigned int TargetRpm; // shift steps only - the rpm the shift should land at, see adapt.h
 	 struct Step *Next;
  };
 
  typedef struct Step *step; // define step as a pointer of data type struct Step
 
+ // the resolved form of a step, built by armRun() so nothing is worked out once the start button is pressed
+ struct Timing
+ {
+	 unsigned long Start; // Offset less the latency trim (us)
+	 unsigned long End; // Start + Duration (us)
+	 unsigned long TriggerPeriod; // tach period at the rpm of the step (ticks)
+	 step Step;
+ };
+
+ // the Timer1 clock every tick is counted in, the system clock or an external reference on T1 (config/conf_blink.h)
+#if CONF_TIMEBASE_EXTERNAL
+ #define TIMEBASE_HZ CONF_TIMEBASE_HZ
+ #define TIMEBASE_CS ((1<<CS12) | (1<<CS11) | (1<<CS10)) // T1 pin, rising edge
+#if TIMEBASE_HZ % 1000000UL != 0 || TIMEBASE_HZ * 5 > F_CPU * 2
+#error "CONF_TIMEBASE_HZ has to be whole MHz and below F_CPU / 2.5 for the T1 synchronizer"
+#endif
+#else
+ #define TIMEBASE_HZ F_CPU
+ #define TIMEBASE_CS (1<<CS10) // system clock, no prescaling
+#endif
+
+ #define TICKS_PER_US (TIMEBASE_HZ / 1000000UL) // TCNT1 counts per microsecond
+
+ struct Stats
+ {
+	 unsigned int RunCount; // number of sequences started since power on
+	 unsigned long LastRunMS; // length of the last run (milliseconds 10-3)
+	 unsigned long LastRunLoops; // number of passes through run() during the last run
+	 unsigned int MaxLoopTicks; // the longest pass through run() seen while running (ticks)
+	 unsigned char MaxTickWork; // the longest run() inside one Timer2 tick while running (Timer2 counts)
+	 unsigned int TickOverruns; // ticks that were missed because run() took too long while running
+	 long EdgeLateTicks[PINS_TOUCH_COUNT]; // start button press interrupt to the first edge of each touch in the last run, less its start time (ticks)
+	 long MaxEdgeLateTicks[PINS_TOUCH_COUNT];
+	 bool IsLastWakeFromPowerDown; // EdgeLateTicks do not include the oscillator start-up time
+ };
+
  struct State
  {
 	 bool IsPressed_StartButton;
 	 bool IsRunning;
-	 bool IsActive_Touch[3];
-	 bool IsComplete_Touch[3];
-	 unsigned long ClockSpeed;
-	 unsigned int ClockPrescaler;
+	 bool IsDryRun; // run the sequence without driving the touch outputs
+	 bool IsRecording; // capture a hand performed launch instead of running, see record.h
+	 bool IsArmed; // the schedule is built and the next press only has to stamp the start time
+	 bool IsActive_Touch[PINS_TOUCH_COUNT];
+	 bool IsComplete_Touch[PINS_TOUCH_COUNT];
+	 bool IsTriggered_Touch[PINS_TOUCH_COUNT]; // the current rpm step has seen its rpm
+	 bool IsRpmArmed_Touch[PINS_TOUCH_COUNT]; // the rpm has been below the rpm of the current step since it became current
+	 bool IsDetectorArmed_Touch[PINS_TOUCH_COUNT]; // the detector of the current step has been off since it became current
+	 unsigned long Start_Touch[PINS_TOUCH_COUNT]; // the time the current step starts (us), from the schedule unless an rpm trigger moved it earlier
+	 unsigned long End_Touch[PINS_TOUCH_COUNT]; // the time the current step ends (us)
+	 unsigned long TriggerPeriod_Touch[PINS_TOUCH_COUNT]; // tach period at the rpm of the current step (ticks)
+	 unsigned int ProfileTrim_Touch[PINS_TOUCH_COUNT]; // actuator latency trims of the active profile (ms), see trim.h
+	 struct Timing *Schedule_Touch[PINS_TOUCH_COUNT]; // one timing per step of TouchDefault, see armRun
+	 unsigned char Index_Touch[PINS_TOUCH_COUNT]; // the timing of the current step
+	 unsigned long NextEventUS; // nothing can switch before this time, the first edge in an armed run
+	 unsigned long ClockSpeed; // current system clock (Hz), see clock.h
+	 unsigned int ClockPrescaler; // current CLKPR setting, a TCNT1 count is worth 2^ClockPrescaler ticks
 	 unsigned long BaseTime; // very first raw clock value after power on device (ticks)
 	 unsigned long StartTime; // clock count at the time the user pressed the start button (ticks)
-	 unsigned long Ticks; // sum total of all raw clock counts after power on device - raw system uptime value (ticks)
+	 unsigned long Ticks; // sum total of all clock counts after power on device, in full speed (TIMEBASE_HZ) ticks - raw system uptime value (ticks)
 	 unsigned long DeltaTime; // the amount of real time passed after pressing the start button (microseconds 10-6)
 	 unsigned long DeltaTimeMS; // the amount of real time passed after pressing the start button (milliseconds 10-3)
 	 unsigned int LastCount; // the last recorded raw clock value
-	 step Touch[3];
-	 step TouchDefault[3];
+	 unsigned int RemainderTicks; // ticks not yet converted into DeltaTime (fixed point only)
+	 unsigned int RemainderUS; // microseconds not yet converted into DeltaTimeMS (fixed point only)
+	 step Touch[PINS_TOUCH_COUNT];
+	 step TouchDefault[PINS_TOUCH_COUNT];
+	 unsigned char Profile; // the active profile, see profile.h
+	 struct Stats Stats;
  };
 
  // prototypes
@@ -39,12 +99,27 @@
  void setOutputs(struct State *state);
  void setStartTime(struct State * state);
  void execute(struct State *state);
+ void startRun(struct State *state);
+ void stopRun(struct State *state);
+ void runBackground(struct State *state);
+ void startRecording(struct State *state);
  void initializeControlRegisters(void);
  void initializeTapSequences(struct State *state);
  void initializeState(struct State *state, unsigned int clockPrescaler, unsigned long clockSpeed);
+ void armRun(struct State *state);
  void resetTouchSteps(struct State *state);
- step createTap(int offset);
- step createTouch(int offset, int duration);
+ unsigned long getTimer1Count(void);
+ void beginStep(struct State *state, int s);
+ step createTap(unsigned long offset);
+ step createTouch(unsigned long offset, unsigned long duration);
+ step createShift(unsigned long offset, unsigned int rpm);
+ step createTriggeredTap(unsigned long offset, unsigned char detector);
+ bool isStepTriggered(struct State *state, int s, step step);
+ unsigned long rpmToPeriod(unsigned int rpm);
+ unsigned int getTrim(struct State *state, int s);
+ void adaptStart(void);
+ void setPressOutputs(unsigned char mask);
+ void watchdogFault(void);
  struct State* initialize(unsigned int clockPrescaler, unsigned long clockSpeed);
 
  void run(struct State *state)
@@ -53,6 +128,12 @@
 	 getUserInput(state);
 	 execute(state);
 	 setOutputs(state);
+
+	 if (!state->IsRunning && !state->IsRecording)
+	 {
+		 // background work only gets the idle loops so it never adds latency to a run
+		 runBackground(state);
+	 }
  }
 
  void initializeState(struct State *state, unsigned int clockPrescaler, unsigned long clockSpeed)
@@ -61,11 +142,14 @@
 	 state->DeltaTime = 0;
 	 state->DeltaTimeMS = 0;
 	 state->IsRunning = false;
+	 state->IsDryRun = false;
+	 state->IsRecording = false;
 	 state->StartTime = 0;
 	 state->Ticks = state->BaseTime;
 	 state->LastCount = state->BaseTime;
 	 state->ClockPrescaler = clockPrescaler;
 	 state->ClockSpeed = clockSpeed;
+	 memset(&state->Stats, 0, sizeof(state->Stats));
 
 	 resetTouchSteps(state);
  }
@@ -89,78 +173,212 @@
 	  // state.LastCount tracks the last raw value of TCNT1 to be used to detect rollovers
 	  // state.Ticks tracks the sum total of all TCNT1 counter events without rollovers
 
-	  int count = TCNT1;
-	  int delta = 0;
-
-	  if (count < state->LastCount)
-	  {
-		  // the time rolled over, so we need to figure out how many ticks occured across the rollover
-		  delta = 65535 - state->LastCount; // get the upper delta
-		  delta += count;  // now add the lower delta after the wrap
-	  }
-	  else
-	  {
-		  // no rollover, just a simple subtraction
-		  delta = count - state->LastCount;
-	  }
+	  unsigned int count = TCNT1;
+	  // modulo 2^16, so a rollover needs no branch and no tick is lost across it
+	  unsigned int delta = (uint16_t)(count - state->LastCount);
 
 	  // increment the Ticks by the delta - ticks is basically a measure of raw uptime
-	  state->Ticks += delta;
+	  // while the system clock is divided down every count is worth more than one tick (see clock.h)
+	  state->Ticks += (unsigned long)delta << state->ClockPrescaler;
 	  state->LastCount = count;
 
 	  if (state->IsRunning)
 	  {
-		  // now update DeltaTime based on delta, cpu speed and prescaling
-		  // tick count / CPU speed => fractional time in seconds; multiply by 1,000,000 to convert to time in microseconds
-		  // for 8 MHz processor, if 1000 ticks elapsed:  (1000 / 8000000) * 1,000,000 = 125 uS
-		  double startDelta = state->Ticks - state->StartTime;
-		  if (state->ClockPrescaler > 0)
+#if CONF_FIXED_POINT_TIME
+		  // convert only this pass's delta and carry the remainders, so the cost is a shift, a mask and at most
+		  // a few subtractions instead of floating point math.  Assumes whole TICKS_PER_US, runs are always at full speed (clock.h)
+		  unsigned long ticks = (unsigned long)delta + state->RemainderTicks; // delta can be close to 65535
+		  unsigned int us = ticks / TICKS_PER_US;
+
+		  state->RemainderTicks = ticks % TICKS_PER_US;
+		  state->DeltaTime += us;
+		  state->RemainderUS += us;
+		  while (state->RemainderUS >= 1000)
 		  {
-			startDelta /= state->ClockPrescaler;
+			  state->RemainderUS -= 1000;
+			  state->DeltaTimeMS++;
 		  }
-		  double deltaUS = ((double)startDelta / ((double)F_CPU)) * 1000000L;
+#else
+		  // now update DeltaTime based on delta and cpu speed, Ticks are already full speed ticks whatever the prescaler
+		  // tick count / timebase => fractional time in seconds; multiply by 1,000,000 to convert to time in microseconds
+		  // for an 8 MHz timebase, if 1000 ticks elapsed:  (1000 / 8000000) * 1,000,000 = 125 uS
+		  double startDelta = state->Ticks - state->StartTime;
+		  double deltaUS = ((double)startDelta / ((double)TIMEBASE_HZ)) * 1000000L;
 		  state->DeltaTime = (long)deltaUS;
 		  state->DeltaTimeMS = (long)(deltaUS / 1000L);
+#endif
+
+		  state->Stats.LastRunLoops++;
+		  if (delta > state->Stats.MaxLoopTicks)
+		  {
+			  state->Stats.MaxLoopTicks = delta;
+		  }
 	  }
   }
 
+ // resolve the active profile into the schedule: trims applied, rpm thresholds turned into periods and the
+ // earliest possible edge worked out.  Called whenever the sequencer goes idle or the steps change
+ void armRun(struct State *state)
+ {
+	 step current;
+	 struct Timing *timing;
+	 unsigned long previousEnd, first, trim = 0;
+	 unsigned char count, outputs;
+	 int s;
+
+	 state->NextEventUS = 0xFFFFFFFFUL;
+	 outputs = 0;
+	 for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	 {
+		 for (current = state->TouchDefault[s], count = 0; current != NULL; current = current->Next)
+		 {
+			 count++;
+		 }
+		 free(state->Schedule_Touch[s]);
+		 state->Schedule_Touch[s] = NULL;
+		 if (count == 0)
+		 {
+			 // a touch without steps has no schedule, beginStep() marks it complete
+			 continue;
+		 }
+		 state->Schedule_Touch[s] = timing = (struct Timing*)malloc(count * sizeof(struct Timing));
+#if CONF_WATCHDOG_ENABLED
+		 if (timing == NULL)
+		 {
+			 // out of heap, nothing after this can be trusted
+			 watchdogFault();
+		 }
+#endif
+
+#if CONF_TRIM_ENABLED
+		 // fire early by the latency of the actuator, rpm and analog triggers can only fire when they see their condition
+		 trim = MS((unsigned long)getTrim(state, s));
+#endif
+		 previousEnd = 0;
+		 for (current = state->TouchDefault[s]; current != NULL; current = current->Next, timing++)
+		 {
+			 timing->Start = current->Offset > trim ? current->Offset - trim : 0;
+			 timing->End = timing->Start + current->Duration;
+			 // one division per step here, so the per-loop rpm check is a plain compare
+			 timing->TriggerPeriod = current->Rpm > 0 ? rpmToPeriod(current->Rpm) : 0;
+			 timing->Step = current;
+
+			 // a triggered step can fire as soon as it becomes the current step
+			 first = (current->Rpm > 0 || current->Detector > 0) ? previousEnd : timing->Start;
+			 if (current->Duration > 0 && first < state->NextEventUS)
+			 {
+				 state->NextEventUS = first;
+			 }
+			 previousEnd = timing->End;
+		 }
+
+		 if (state->Schedule_Touch[s][0].Start == 0 && state->TouchDefault[s]->Duration > 0)
+		 {
+			 outputs |= 1<<s;
+		 }
+	 }
+
+	 if (state->NextEventUS == 0xFFFFFFFFUL)
+	 {
+		 // placeholders only, let the run finish straight away
+		 state->NextEventUS = 0;
+	 }
+
+	 resetTouchSteps(state);
+	 state->Stats.LastRunLoops = 0;
+#if CONF_ADAPT_ENABLED
+	 adaptStart();
+#endif
+#if CONF_START_INTERRUPT
+	 // the press interrupt switches these on itself
+	 setPressOutputs(outputs);
+#endif
+	 state->IsArmed = true;
+ }
+
  void resetTouchSteps(struct State *state)
  {
-	 state->Touch[0] = state->TouchDefault[0];
-	 state->Touch[1] = state->TouchDefault[1];
-	 state->Touch[2] = state->TouchDefault[2];
-	 state->IsActive_Touch[0] = false;
-	 state->IsActive_Touch[1] = false;
-	 state->IsActive_Touch[2] = false;
-	 state->IsComplete_Touch[0] = false;
-	 state->IsComplete_Touch[1] = false;
-	 state->IsComplete_Touch[2] = false;
+	 int s;
+
+	 for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	 {
+		 state->Touch[s] = state->TouchDefault[s];
+		 state->IsActive_Touch[s] = false;
+		 state->IsComplete_Touch[s] = false;
+		 state->Index_Touch[s] = 0;
+		 beginStep(state, s);
+	 }
+ }
+
+ // called when Touch[s] moves to a new step, everything comes out of the armed schedule
+ void beginStep(struct State *state, int s)
+ {
+	 struct Timing *timing;
+
+	 if (state->Schedule_Touch[s] == NULL)
+	 {
+		 state->Start_Touch[s] = state->End_Touch[s] = 0;
+		 state->IsComplete_Touch[s] = true;
+		 return;
+	 }
+	 timing = &state->Schedule_Touch[s][state->Index_Touch[s]];
+
+	 state->Start_Touch[s] = timing->Start;
+	 state->End_Touch[s] = timing->End;
+	 state->TriggerPeriod_Touch[s] = timing->TriggerPeriod;
+	 state->IsTriggered_Touch[s] = false;
+	 state->IsRpmArmed_Touch[s] = false;
+	 state->IsDetectorArmed_Touch[s] = false;
  }
 
  
- step createTap(int offset)
+ step createTap(unsigned long offset)
  {
 	 step new;
 	 new = (step)malloc(sizeof(struct Step));
 	 new->Offset = offset;
-	 new->Duration = 25;
+	 new->Duration = MS(25);
+	 new->Rpm = 0;
+	 new->Detector = 0;
+	 new->TargetRpm = 0;
 	 new->Next = NULL;
 	 return new;
  }
 
- step createTouch(int offset, int duration)
+ step createTouch(unsigned long offset, unsigned long duration)
  {
 	 step new;
 	 new = (step)malloc(sizeof(struct Step));
 	 new->Offset = offset;
 	 new->Duration = duration;
+	 new->Rpm = 0;
+	 new->Detector = 0;
+	 new->TargetRpm = 0;
 	 new->Next = NULL;
 	 return new;
  }
 
+ // a tap that fires as soon as the tach reaches rpm, or at offset if it never gets there
+ step createShift(unsigned long offset, unsigned int rpm)
+ {
+	 step new = createTap(offset);
+	 new->Rpm = rpm;
+	 return new;
+ }
+
+ // a tap that fires as soon as analog detector (detector - 1) switches on, or at offset if it never does
+ step createTriggeredTap(unsigned long offset, unsigned char detector)
+ {
+	 step new = createTap(offset);
+	 new->Detector = detector;
+	 return new;
+ }
+
  void setStartTime(struct State *state)
  {
 	 state->StartTime = state->Ticks;
 	 state->DeltaTime = 0;
 	 state->DeltaTimeMS = 0;
+	 state->RemainderTicks = 0;
+	 state->RemainderUS = 0;
  }
\ No newline at end of file
@@ -0,0 +1,325 @@
+/*
+ * osccal.h
+ *
+ * Created: 10/19/2026 3:02:51 PM
+ *  Author: odinh
+ */
+
+
+#ifndef OSCCAL_H_
+#define OSCCAL_H_
+
+// internal RC oscillator calibration.  The factory OSCCAL is only good to a few percent, which is over 100 ms
+// on a 4 s offset.  OSCCAL is tuned against a reference - a 32.768 kHz watch crystal on Timer2 in async mode,
+// or a stream of 'U' characters on RXD, which is a square wave with a period of two bit times - and stored in
+// EEPROM for the temperature band the internal sensor (ADC8) reads at the time.  At power up and every
+// CONF_OSCCAL_CHECK_S while idle the value for the current band (or the nearest calibrated one) is applied
+#define OSCCAL_MAGIC 0x4F43 // "OC"
+#define OSCCAL_TEMP_BASE 242 // sensor reading at about -45 C, roughly 1 count per degree
+#define OSCCAL_TEMP_STEP 16
+#define OSCCAL_TEMP_BANDS 10
+#define OSCCAL_NONE 0xFF
+#define OSCCAL_CHECK_OVERFLOWS (unsigned int)(CONF_OSCCAL_CHECK_S * (TIMEBASE_HZ / 65536UL))
+#define OSCCAL_TIMEOUT_LOOPS 2000000UL // roughly a few seconds of polling at 8 MHz
+
+#if CONF_OSCCAL_CRYSTAL
+#define OSCCAL_CRYSTAL_COUNTS 128 // 3.9 ms, short enough not to wrap TCNT1 up to twice the nominal clock
+#define OSCCAL_EXPECTED_TICKS (unsigned int)(F_CPU * OSCCAL_CRYSTAL_COUNTS / 32768UL)
+#else
+#define OSCCAL_UART_PERIODS 8 // 16 bit times
+#define OSCCAL_EXPECTED_TICKS (unsigned int)(F_CPU * 2UL * OSCCAL_UART_PERIODS / CONF_UART_BAUD)
+#endif
+
+struct OsccalTable
+{
+	uint16_t Magic;
+	unsigned char Value[OSCCAL_TEMP_BANDS]; // OSCCAL_NONE for bands that were never calibrated
+};
+
+EEMEM struct OsccalTable OsccalTable;
+
+unsigned int OsccalTemperature; // the last temperature sensor reading
+unsigned int OsccalCheckSince; // Timer1 overflow count at the last temperature check
+
+// prototypes
+void initializeOsccal(void);
+void osccalPoll(void);
+bool osccalCalibrate(void);
+unsigned int osccalMeasure(void);
+unsigned int osccalTemperature(void);
+unsigned char osccalBand(unsigned int temperature);
+unsigned char osccalLookup(unsigned char band);
+void osccalWalk(unsigned char target);
+
+// called from main before the other peripherals are set up
+void initializeOsccal(void)
+{
+	OsccalTemperature = osccalTemperature();
+	OsccalCheckSince = Timer1Overflows;
+#if CONF_OSCCAL_CRYSTAL
+	if (eeprom_read_word(&OsccalTable.Magic) != OSCCAL_MAGIC
+		|| eeprom_read_byte(&OsccalTable.Value[osccalBand(OsccalTemperature)]) == OSCCAL_NONE)
+	{
+		// first power up in this temperature band
+		osccalCalibrate();
+		return;
+	}
+#endif
+	osccalWalk(osccalLookup(osccalBand(OsccalTemperature)));
+}
+
+// called from runBackground
+void osccalPoll(void)
+{
+	if (Timer1Overflows - OsccalCheckSince < (OSCCAL_CHECK_OVERFLOWS >> ClockShift))
+	{
+		return;
+	}
+
+	OsccalCheckSince = Timer1Overflows;
+	OsccalTemperature = osccalTemperature();
+	osccalWalk(osccalLookup(osccalBand(OsccalTemperature)));
+}
+
+// tune OSCCAL against the reference and store it for the current temperature band, false without a reference
+bool osccalCalibrate(void)
+{
+	unsigned char lo = OSCCAL & 0x80; // the two OSCCAL ranges overlap, stay in the factory one
+	unsigned char hi = lo | 0x7F;
+	unsigned char mid, band;
+	unsigned int ticks, below;
+	bool isCalibrated = false;
+	unsigned char original = OSCCAL;
+	irqflags_t flags;
+#if CONF_TIMEBASE_EXTERNAL
+	unsigned int count;
+	bool isOverflowPending;
+#endif
+#if CONF_OSCCAL_CRYSTAL
+	unsigned char prr = PRR;
+
+	PRR &= ~(1<<PRTIM2);
+	TIMSK2 = 0;
+	ASSR = (1<<AS2);
+	TCNT2 = 0;
+	TCCR2A = 0;
+	TCCR2B = (1<<CS20);
+	while (ASSR & ((1<<TCN2UB) | (1<<TCR2AUB) | (1<<TCR2BUB)))
+	{
+	}
+	// watch crystal start-up
+	_delay_ms(1000);
+#endif
+
+	// the reference is polled, nothing else may run in between
+	flags = cpu_irq_save();
+#if CONF_TIMEBASE_EXTERNAL
+	// the measurement counts CPU cycles, Timer1 is switched over to the system clock for it and the timebase
+	// stands still until it is switched back
+	count = TCNT1;
+	isOverflowPending = TIFR1 & (1<<TOV1);
+	TCCR1B = (1<<CS10);
+#endif
+
+	// a higher OSCCAL is a faster clock and more Timer1 ticks per reference period, find the first value that
+	// reaches the expected count.  Larger jumps than a couple of percent upset the CPU, so OSCCAL is walked
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		osccalWalk(mid);
+		ticks = osccalMeasure();
+		if (ticks == 0)
+		{
+			break;
+		}
+		if (ticks < OSCCAL_EXPECTED_TICKS)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	if (lo == hi)
+	{
+		// the value just below may be closer
+		osccalWalk(lo);
+		ticks = osccalMeasure();
+		if ((lo & 0x7F) > 0 && ticks > OSCCAL_EXPECTED_TICKS)
+		{
+			osccalWalk(lo - 1);
+			below = osccalMeasure();
+			if (below == 0 || OSCCAL_EXPECTED_TICKS - below >= ticks - OSCCAL_EXPECTED_TICKS)
+			{
+				osccalWalk(lo);
+			}
+		}
+		isCalibrated = ticks != 0;
+	}
+	if (!isCalibrated)
+	{
+		osccalWalk(original);
+	}
+#if CONF_TIMEBASE_EXTERNAL
+	TCCR1B = TIMEBASE_CS;
+	TCNT1 = count;
+	if (!isOverflowPending)
+	{
+		TIFR1 = (1<<TOV1);
+	}
+#endif
+	cpu_irq_restore(flags);
+
+#if CONF_OSCCAL_CRYSTAL
+	TCCR2B = 0;
+	ASSR = 0;
+	PRR = prr;
+#endif
+
+	if (isCalibrated)
+	{
+		if (eeprom_read_word(&OsccalTable.Magic) != OSCCAL_MAGIC)
+		{
+			for (band = 0; band < OSCCAL_TEMP_BANDS; band++)
+			{
+				eeprom_update_byte(&OsccalTable.Value[band], OSCCAL_NONE);
+			}
+			eeprom_update_word(&OsccalTable.Magic, OSCCAL_MAGIC);
+		}
+		eeprom_update_byte(&OsccalTable.Value[osccalBand(OsccalTemperature)], OSCCAL);
+	}
+	return isCalibrated;
+}
+
+// CPU cycles (Timer1 ticks) over one reference interval, 0 when the reference does not show up.  Call with interrupts disabled
+unsigned int osccalMeasure(void)
+{
+	unsigned long timeout = OSCCAL_TIMEOUT_LOOPS;
+	unsigned int start = 0;
+#if CONF_OSCCAL_CRYSTAL
+	unsigned char count = TCNT2;
+
+	// line up with a crystal count first
+	while (TCNT2 == count)
+	{
+		if (--timeout == 0)
+		{
+			return 0;
+		}
+	}
+	start = TCNT1;
+	count = TCNT2 + OSCCAL_CRYSTAL_COUNTS;
+	while (TCNT2 != count)
+	{
+		if (--timeout == 0)
+		{
+			return 0;
+		}
+	}
+#else
+	unsigned char edges;
+
+	// the polling delay after each falling edge is the same every time, so it drops out of the difference
+	for (edges = 0; edges <= OSCCAL_UART_PERIODS; edges++)
+	{
+		while (!(PIND & (1<<PIND0)))
+		{
+			if (--timeout == 0)
+			{
+				return 0;
+			}
+		}
+		while (PIND & (1<<PIND0))
+		{
+			if (--timeout == 0)
+			{
+				return 0;
+			}
+		}
+		if (edges == 0)
+		{
+			start = TCNT1;
+		}
+	}
+#endif
+	return TCNT1 - start;
+}
+
+// one conversion of the internal temperature sensor, the free running ADC is restarted afterwards
+unsigned int osccalTemperature(void)
+{
+	unsigned char prr = PRR;
+	unsigned char i;
+	unsigned int value = 0;
+
+	PRR &= ~(1<<PRADC);
+	ADCSRA = (1<<ADIF);
+	ADMUX = (1<<REFS1) | (1<<REFS0) | (1<<MUX3); // internal 1.1 V reference, ADC8
+	ADCSRA = (1<<ADEN) | clockAdcPrescaler();
+	// the first conversions after switching to the internal reference are off, keep the last one
+	for (i = 0; i < 4; i++)
+	{
+		ADCSRA |= (1<<ADSC);
+		while (ADCSRA & (1<<ADSC))
+		{
+		}
+		value = ADC;
+	}
+	ADCSRA = (1<<ADIF);
+	PRR = prr;
+
+#if CONF_ADC_ENABLED
+	initializeAdc();
+#endif
+	return value;
+}
+
+unsigned char osccalBand(unsigned int temperature)
+{
+	unsigned int band;
+
+	if (temperature <= OSCCAL_TEMP_BASE)
+	{
+		return 0;
+	}
+	band = (temperature - OSCCAL_TEMP_BASE) / OSCCAL_TEMP_STEP;
+	return band < OSCCAL_TEMP_BANDS ? band : OSCCAL_TEMP_BANDS - 1;
+}
+
+// the stored value for band, or for the nearest calibrated band.  The current OSCCAL when there is none
+unsigned char osccalLookup(unsigned char band)
+{
+	unsigned char distance, value;
+
+	if (eeprom_read_word(&OsccalTable.Magic) != OSCCAL_MAGIC)
+	{
+		return OSCCAL;
+	}
+
+	for (distance = 0; distance < OSCCAL_TEMP_BANDS; distance++)
+	{
+		if (band >= distance && (value = eeprom_read_byte(&OsccalTable.Value[band - distance])) != OSCCAL_NONE)
+		{
+			return value;
+		}
+		if (band + distance < OSCCAL_TEMP_BANDS
+			&& (value = eeprom_read_byte(&OsccalTable.Value[band + distance])) != OSCCAL_NONE)
+		{
+			return value;
+		}
+	}
+	return OSCCAL;
+}
+
+// move OSCCAL one step at a time
+void osccalWalk(unsigned char target)
+{
+	while (OSCCAL != target)
+	{
+		OSCCAL += OSCCAL < target ? 1 : -1;
+	}
+}
+
+#endif /* OSCCAL_H_ */
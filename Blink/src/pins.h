@@ -0,0 +1,90 @@
+/*
+ * pins.h
+ *
+ * Created: 10/23/2026 9:26:14 AM
+ *  Author: odinh
+ */
+
+
+#ifndef PINS_H_
+#define PINS_H_
+
+// board pin map.  Every channel is an ioport pin (IOPORT_CREATE_PIN) known at compile time, so the ioport_*
+// calls on it fold down to a single sbi, cbi, sbic or sbis - a board revision that moves a channel only changes
+// this table.  The touch outputs have to share a port, the press interrupt switches them on with one write, and
+// the start button has to stay on PORTB for PCINT0.  Pins that belong to a peripheral (RXD, TXD, INT1, the timer
+// compare outputs) are not channels and are not in here.  PINS_TOUCHES lists the touch channels, code that
+// has to run for every channel expands it with X(s, pin, arg) for each, so it is written once for any number of
+// channels and every pin is still a constant - there is no pin table at run time
+#define PIN_TOUCH0 IOPORT_CREATE_PIN(PORTD, 0) // start pedal
+#define PIN_TOUCH1 IOPORT_CREATE_PIN(PORTD, 1) // shift paddle
+#define PIN_TOUCH2 IOPORT_CREATE_PIN(PORTD, 2) // NO2 button
+#define PIN_LED_GREEN IOPORT_CREATE_PIN(PORTB, 1)
+#define PIN_LED_RED IOPORT_CREATE_PIN(PORTB, 2)
+#define PIN_START IOPORT_CREATE_PIN(PORTB, 0) // active low, internal pull-up
+#define PINS_TOUCHES(X, arg) X(0, PIN_TOUCH0, arg) X(1, PIN_TOUCH1, arg) X(2, PIN_TOUCH2, arg)
+
+#define PIN_MASK(pin) (1 << ((pin) & 0x07))
+#define PINS_TOUCH_COUNT (0 PINS_TOUCHES(PINS_COUNT_OF, ~)) // sizes the per touch arrays of struct State
+#define PINS_TOUCH_PORT (PIN_TOUCH0 >> 3)
+#define PINS_TOUCH_MASK (0 PINS_TOUCHES(PINS_MASK_OF, ~))
+#define PINS_TOUCH_LATCH (arch_ioport_port_to_base(PINS_TOUCH_PORT)->PORTDATA) // PORTx of the touch outputs
+#define PINS_TOUCH_DIR (arch_ioport_port_to_base(PINS_TOUCH_PORT)->DIR)
+#define PINS_TOUCH_BITS(touches) (0 PINS_TOUCHES(PINS_BIT_OF, touches)) // touch mask (bit s) to touch port bits
+#define PINS_TOUCH_ACTIVE(state) (0 PINS_TOUCHES(PINS_ACTIVE_OF, state)) // touch port bits of the active touches
+
+// the pieces PINS_TOUCHES is expanded with
+#define PINS_MASK_OF(s, pin, arg) | PIN_MASK(pin)
+#define PINS_BIT_OF(s, pin, touches) | (((touches) & (1<<(s))) ? PIN_MASK(pin) : 0)
+#define PINS_ACTIVE_OF(s, pin, state) | ((state)->IsActive_Touch[s] ? PIN_MASK(pin) : 0)
+#define PINS_LATCHED_OF(s, pin, latch) | (((latch) & PIN_MASK(pin)) ? (1<<(s)) : 0)
+#define PINS_PORT_OF(s, pin, arg) || ((pin) >> 3) != PINS_TOUCH_PORT
+#define PINS_COUNT_OF(s, pin, arg) + 1
+#define PINS_OUTPUT_OF(s, pin, arg) ioport_set_pin_dir(pin, IOPORT_DIR_OUTPUT);
+
+#if 0 PINS_TOUCHES(PINS_PORT_OF, ~)
+#error "the touch outputs have to be on the same port"
+#endif
+#if PINS_TOUCH_COUNT > 8
+#error "touch masks are one bit per touch in an unsigned char"
+#endif
+#if (PIN_START >> 3) != IOPORT_PORTB
+#error "the start button is read by PCINT0, it has to be on PORTB"
+#endif
+
+// prototypes
+void initializePins(void);
+bool pinsIsStartPressed(void);
+unsigned char pinsTouchBits(unsigned char touches);
+unsigned char pinsTouchLatched(void);
+
+// called from initializeControlRegisters
+void initializePins(void)
+{
+	ioport_set_pin_dir(PIN_LED_GREEN, IOPORT_DIR_OUTPUT);
+	ioport_set_pin_dir(PIN_LED_RED, IOPORT_DIR_OUTPUT);
+	PINS_TOUCHES(PINS_OUTPUT_OF, ~)
+	ioport_set_pin_dir(PIN_START, IOPORT_DIR_INPUT);
+	ioport_set_pin_level(PIN_START, IOPORT_PIN_LEVEL_HIGH); // pull-up
+}
+
+bool pinsIsStartPressed(void)
+{
+	return !ioport_get_pin_level(PIN_START);
+}
+
+// touch mask (bit s for touch s) to their bits in the touch port
+unsigned char pinsTouchBits(unsigned char touches)
+{
+	return PINS_TOUCH_BITS(touches);
+}
+
+// touch mask of the outputs that are switched on
+unsigned char pinsTouchLatched(void)
+{
+	unsigned char latch = PINS_TOUCH_LATCH;
+
+	return 0 PINS_TOUCHES(PINS_LATCHED_OF, latch);
+}
+
+#endif /* PINS_H_ */
@@ -0,0 +1,115 @@
+/*
+ * power.h
+ *
+ * Created: 10/19/2026 10:32:08 AM
+ *  Author: odinh
+ */
+
+
+#ifndef POWER_H_
+#define POWER_H_
+
+// idle power management.  Unused peripherals are gated off in PRR at power up.  While nothing is running the
+// CPU sleeps in idle between interrupts - the Timer1 overflow wakes it at least every 65536 ticks so getClockTime()
+// keeps up - and after CONF_POWER_DOWN_AFTER_S without a button press it drops into power-down until a pin
+// change on the start button (PCINT0, see press.h)
+#define POWER_DOWN_OVERFLOWS (unsigned int)(CONF_POWER_DOWN_AFTER_S * (TIMEBASE_HZ / 65536UL))
+
+unsigned int IdleSince; // Timer1 overflow count at the end of the last activity
+bool IsPoweredDown; // the last press woke the CPU from power-down, the benchmark adds no oscillator start-up
+
+// prototypes
+void initializePower(void);
+void sleepWhileIdle(struct State *state);
+void powerDown(void);
+
+void initializePower(void)
+{
+	// nothing uses TWI, SPI or Timer0
+	PRR = (1<<PRTWI) | (1<<PRSPI) | (1<<PRTIM0);
+#if !CONF_ADC_ENABLED
+	ADCSRA = 0;
+	ACSR |= (1<<ACD);
+	PRR |= (1<<PRADC);
+#endif
+#if !CONF_SHELL_ENABLED
+	PRR |= (1<<PRUSART0);
+#endif
+#if !CONF_TICK_ENABLED
+	PRR |= (1<<PRTIM2);
+#endif
+
+	// Timer1 overflows pace idle sleep and count the time to power-down
+	TIMSK1 |= (1<<TOIE1);
+
+	IdleSince = Timer1Overflows;
+	set_sleep_mode(SLEEP_MODE_IDLE);
+}
+
+// called from main after every pass through run()
+void sleepWhileIdle(struct State *state)
+{
+	if (state->IsRunning || state->IsRecording || state->IsPressed_StartButton)
+	{
+		IdleSince = Timer1Overflows;
+		return;
+	}
+
+#if !CONF_SHELL_ENABLED
+	// power-down stops the USART, so it is only used when there is no shell to talk to
+	if (Timer1Overflows - IdleSince >= (POWER_DOWN_OVERFLOWS >> ClockShift))
+	{
+		powerDown();
+		IdleSince = Timer1Overflows;
+		return;
+	}
+#endif
+
+#if !CONF_TICK_ENABLED
+	// in tick mode waitForTick() already idles between ticks
+	cli();
+	sleep_enable();
+	sei();
+	sleep_cpu();
+	sleep_disable();
+#endif
+}
+
+void powerDown(void)
+{
+	// both LEDs off while asleep, setOutputs() puts them back on the next pass
+	ioport_set_pin_level(PIN_LED_GREEN, IOPORT_PIN_LEVEL_LOW);
+	ioport_set_pin_level(PIN_LED_RED, IOPORT_PIN_LEVEL_LOW);
+#if CONF_ADC_ENABLED
+	ADCSRA = 0;
+	PRR |= (1<<PRADC);
+#endif
+
+#if CONF_WATCHDOG_ENABLED
+	// only the start button wakes from power-down
+	watchdogPause();
+#endif
+	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+	cli();
+	if (!pinsIsStartPressed())
+	{
+		sleep_enable();
+		sleep_bod_disable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+		IsPoweredDown = true;
+	}
+	sei();
+	set_sleep_mode(SLEEP_MODE_IDLE);
+#if CONF_WATCHDOG_ENABLED
+	watchdogResume();
+#endif
+
+#if CONF_ADC_ENABLED
+	PRR &= ~(1<<PRADC);
+	initializeAdc();
+#endif
+}
+
+#endif /* POWER_H_ */
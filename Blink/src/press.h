@@ -0,0 +1,61 @@
+/*
+ * press.h
+ *
+ * Created: 10/19/2026 7:21:44 PM
+ *  Author: odinh
+ */
+
+
+#ifndef PRESS_H_
+#define PRESS_H_
+
+// start button pin change interrupt (PCINT0, PIN_START on PORTB).  Every press is stamped with Timer1, which wakes the CPU
+// from power-down and gives the latency benchmark its starting point.  With CONF_START_INTERRUPT the handler
+// also switches on the touch outputs whose first step starts at zero straight away (armRun() works out which)
+// and leaves the press pending for the main loop, so a press shorter than a pass still starts the run
+#define PRESS_ENABLED (CONF_POWER_ENABLED || CONF_BENCH_ENABLED || CONF_START_INTERRUPT)
+
+volatile unsigned long PressStamp; // Timer1 stamp (full speed ticks) of the last press
+volatile unsigned char PressFired; // touch outputs the last press switched on by itself
+volatile unsigned char PressOutputs; // touch outputs the next press switches on by itself
+volatile unsigned char PressBits; // PressOutputs in the touch port
+volatile bool IsPressPending;
+
+// prototypes
+void initializePress(void);
+void setPressOutputs(unsigned char mask);
+
+void initializePress(void)
+{
+	PCMSK0 |= PIN_MASK(PIN_START); // PCINT0 - PCINT7 are PB0 - PB7
+	PCIFR = (1<<PCIF0);
+	PCICR |= (1<<PCIE0);
+}
+
+// called from armRun with the zero offset outputs, and with 0 whenever a press must not drive anything.  Wave
+// outputs are not on their touch port bit, waveStart() forces their first edge instead
+void setPressOutputs(unsigned char mask)
+{
+	irqflags_t flags = cpu_irq_save();
+
+	PressOutputs = mask & ~WAVE_MASK;
+	PressBits = pinsTouchBits(PressOutputs);
+	cpu_irq_restore(flags);
+}
+
+ISR(PCINT0_vect)
+{
+	if (pinsIsStartPressed())
+	{
+		// the outputs first, everything else is bookkeeping.  setOutputs() writes the touch port with interrupts
+		// off, so this can not be undone by an interrupted read-modify-write
+		PINS_TOUCH_LATCH |= PressBits;
+		PressStamp = getTimer1Stamp();
+		PressFired = PressOutputs;
+		PressOutputs = 0;
+		PressBits = 0;
+		IsPressPending = true;
+	}
+}
+
+#endif /* PRESS_H_ */
@@ -0,0 +1,243 @@
+/*
+ * profile.h
+ *
+ * Created: 10/18/2026 9:41:17 AM
+ *  Author: odinh
+ */
+
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+// every profile owns one EEPROM slot.  The first slots belong to the built-in sequences in main.c and
+// hold their tuned copies, the remaining slots are user profiles that only exist in EEPROM
+#define PROFILE_SLOT_COUNT 4
+#define PROFILE_MAX_STEPS 16
+#define PROFILE_MAGIC 0x4343 // "CC"
+#define PROFILE_VERSION 6
+
+struct ProfileStep
+{
+	uint32_t Offset; // microseconds
+	uint32_t Duration;
+	unsigned int Rpm;
+	unsigned char Detector;
+	unsigned int TargetRpm;
+};
+
+struct ProfileSlot
+{
+	uint16_t Magic;
+	unsigned char Version;
+	unsigned char Count[PINS_TOUCH_COUNT]; // number of steps stored for each touch sequence
+	uint16_t Trim[PINS_TOUCH_COUNT]; // latency trims of the profile, TRIM_NONE for the channel defaults (see trim.h)
+	struct ProfileStep Steps[PROFILE_MAX_STEPS];
+};
+
+struct Profile
+{
+	const char *Name; // PROGMEM string
+	void (*Initialize)(struct State *state);
+};
+
+EEMEM struct ProfileSlot ProfileSlots[PROFILE_SLOT_COUNT];
+EEMEM unsigned char ActiveProfile;
+
+// the built-in sequences are defined in main.c
+extern const struct Profile Profiles[];
+extern const unsigned char BuiltinProfileCount;
+extern const unsigned char DefaultProfile;
+
+// prototypes
+void loadProfile(struct State *state, unsigned char profile);
+unsigned char readActiveProfile(void);
+bool isBuiltinProfile(unsigned char profile);
+bool isProfileSlotValid(unsigned char slot);
+bool readProfileSlot(struct State *state, unsigned char slot);
+bool saveProfileSlot(struct State *state, unsigned char slot);
+void eraseProfileSlot(unsigned char slot);
+void freeSteps(step s);
+unsigned char countSteps(step s);
+
+void loadProfile(struct State *state, unsigned char profile)
+{
+	int s;
+
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		freeSteps(state->TouchDefault[s]);
+		state->TouchDefault[s] = NULL;
+		state->ProfileTrim_Touch[s] = TRIM_NONE;
+	}
+
+	// a tuned copy in EEPROM wins over the compiled-in defaults
+	if (!readProfileSlot(state, profile))
+	{
+		if (!isBuiltinProfile(profile))
+		{
+			// empty user slot - fall back to the first built-in sequence
+			profile = 0;
+		}
+		Profiles[profile].Initialize(state);
+		for (s = 0; s < PINS_TOUCH_COUNT; s++)
+		{
+			if (state->TouchDefault[s] == NULL)
+			{
+				// a built-in sequence leaves the touches it does not use empty, same placeholder as readProfileSlot
+				state->TouchDefault[s] = createTouch(0, 0);
+			}
+		}
+	}
+
+	state->Profile = profile;
+	eeprom_update_byte(&ActiveProfile, profile);
+	armRun(state);
+}
+
+unsigned char readActiveProfile(void)
+{
+	unsigned char profile = eeprom_read_byte(&ActiveProfile);
+
+	// erased EEPROM reads back as 0xFF
+	if (profile >= PROFILE_SLOT_COUNT)
+	{
+		profile = DefaultProfile;
+	}
+	return profile;
+}
+
+bool isBuiltinProfile(unsigned char profile)
+{
+	return profile < BuiltinProfileCount;
+}
+
+bool isProfileSlotValid(unsigned char slot)
+{
+	return slot < PROFILE_SLOT_COUNT
+		&& eeprom_read_word(&ProfileSlots[slot].Magic) == PROFILE_MAGIC
+		&& eeprom_read_byte(&ProfileSlots[slot].Version) == PROFILE_VERSION;
+}
+
+bool readProfileSlot(struct State *state, unsigned char slot)
+{
+	unsigned char count[PINS_TOUCH_COUNT];
+	struct ProfileStep stored;
+	step current, tmp;
+	int s, i, n = 0;
+
+	if (!isProfileSlotValid(slot))
+	{
+		return false;
+	}
+
+	eeprom_read_block(count, ProfileSlots[slot].Count, sizeof(count));
+	eeprom_read_block(state->ProfileTrim_Touch, ProfileSlots[slot].Trim, sizeof(state->ProfileTrim_Touch));
+
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		current = NULL;
+
+		for (i = 0; i < count[s] && n < PROFILE_MAX_STEPS; i++, n++)
+		{
+			eeprom_read_block(&stored, &ProfileSlots[slot].Steps[n], sizeof(stored));
+			tmp = createTouch(stored.Offset, stored.Duration);
+			tmp->Rpm = stored.Rpm;
+			tmp->Detector = stored.Detector;
+			tmp->TargetRpm = stored.TargetRpm;
+
+			if (current == NULL)
+			{
+				state->TouchDefault[s] = tmp;
+			}
+			else
+			{
+				current->Next = tmp;
+			}
+			current = tmp;
+		}
+
+		if (current == NULL)
+		{
+			// the sequencer expects every touch to have at least one step, zero duration steps are placeholders
+			state->TouchDefault[s] = createTouch(0, 0);
+		}
+	}
+	return true;
+}
+
+bool saveProfileSlot(struct State *state, unsigned char slot)
+{
+	unsigned char count[PINS_TOUCH_COUNT];
+	struct ProfileStep stored;
+	step current;
+	int s, n = 0;
+
+	if (slot >= PROFILE_SLOT_COUNT)
+	{
+		return false;
+	}
+
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		count[s] = countSteps(state->TouchDefault[s]);
+		n += count[s];
+	}
+
+	if (n > PROFILE_MAX_STEPS)
+	{
+		return false;
+	}
+
+	// invalidate the slot first so a reset half way through never leaves a mixed profile behind
+	eraseProfileSlot(slot);
+
+	n = 0;
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		for (current = state->TouchDefault[s]; current != NULL; current = current->Next, n++)
+		{
+			stored.Offset = current->Offset;
+			stored.Duration = current->Duration;
+			stored.Rpm = current->Rpm;
+			stored.Detector = current->Detector;
+			stored.TargetRpm = current->TargetRpm;
+			eeprom_update_block(&stored, &ProfileSlots[slot].Steps[n], sizeof(stored));
+		}
+	}
+
+	eeprom_update_block(count, ProfileSlots[slot].Count, sizeof(count));
+	eeprom_update_block(state->ProfileTrim_Touch, ProfileSlots[slot].Trim, sizeof(state->ProfileTrim_Touch));
+	eeprom_update_byte(&ProfileSlots[slot].Version, PROFILE_VERSION);
+	eeprom_update_word(&ProfileSlots[slot].Magic, PROFILE_MAGIC);
+	return true;
+}
+
+void eraseProfileSlot(unsigned char slot)
+{
+	eeprom_update_word(&ProfileSlots[slot].Magic, 0xFFFF);
+}
+
+void freeSteps(step s)
+{
+	step next;
+
+	while (s != NULL)
+	{
+		next = s->Next;
+		free(s);
+		s = next;
+	}
+}
+
+unsigned char countSteps(step s)
+{
+	unsigned char count = 0;
+
+	for (; s != NULL; s = s->Next)
+	{
+		count++;
+	}
+	return count;
+}
+
+#endif /* PROFILE_H_ */
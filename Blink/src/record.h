@@ -0,0 +1,282 @@
+/*
+ * record.h
+ *
+ * Created: 10/18/2026 1:37:52 PM
+ *  Author: odinh
+ */
+
+
+#ifndef RECORD_H_
+#define RECORD_H_
+
+// record mode - the driver performs the launch by hand and every edge on the record inputs (PC0 up,
+// one per touch sequence, active low) is captured into a new profile.  The pin change interrupt only
+// stamps TCNT1 and the pin levels into a ring buffer, the main loop turns the stamps into steps
+#define RECORD_BUFFER_SIZE 16 // power of two
+#define RECORD_PIN_MASK ((1 << PINS_TOUCH_COUNT) - 1) // PCs is the input of touch s
+#define RECORD_MIN_MS 5 // presses shorter than this are contact bounce
+
+#if PINS_TOUCH_COUNT > 6
+#error "record mode has an input on PORTC for every touch, PC0 - PC5"
+#endif
+
+struct Edge
+{
+	unsigned int Stamp; // raw TCNT1 value at the time of the edge
+	unsigned char Pins; // PINC after the edge
+};
+
+struct Recorder
+{
+	bool IsStarted;
+	bool WasReleased; // the start button has to be released before the next press counts
+	unsigned char Pins; // the last pin levels that were turned into steps
+	unsigned char Count; // total steps recorded
+	unsigned char Dropped; // edges lost to a full buffer
+	unsigned long PressTicks[PINS_TOUCH_COUNT];
+	step Head[PINS_TOUCH_COUNT];
+	step Tail[PINS_TOUCH_COUNT];
+};
+
+volatile struct Edge RecordBuffer[RECORD_BUFFER_SIZE];
+volatile unsigned char RecordHead;
+volatile unsigned char RecordTail;
+volatile unsigned char RecordDropped;
+struct Recorder Recorder;
+
+// prototypes
+void startRecording(struct State *state);
+void record(struct State *state);
+void recordEdges(struct State *state);
+void recordStep(struct State *state, unsigned char touch, unsigned long pressTicks, unsigned long releaseTicks);
+bool recordFits(unsigned char touch);
+bool recordIsFull(void);
+void finishRecording(struct State *state);
+
+void startRecording(struct State *state)
+{
+	int s;
+
+#if CONF_START_INTERRUPT
+	// the presses that mark the recording must not drive the touch outputs
+	setPressOutputs(0);
+#endif
+
+	memset(&Recorder, 0, sizeof(Recorder));
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		Recorder.Head[s] = NULL;
+		Recorder.Tail[s] = NULL;
+	}
+
+	// record inputs with pull-ups
+	DDRC &= ~RECORD_PIN_MASK;
+	PORTC |= RECORD_PIN_MASK;
+
+	state->IsRecording = true;
+}
+
+// called from execute while recording
+void record(struct State *state)
+{
+	if (!state->IsPressed_StartButton)
+	{
+		Recorder.WasReleased = true;
+	}
+
+	if (!Recorder.IsStarted)
+	{
+		if (Recorder.WasReleased && state->IsPressed_StartButton)
+		{
+			// the start button marks zero, just like it does for a run
+			setStartTime(state);
+			Recorder.IsStarted = true;
+			Recorder.WasReleased = false;
+			Recorder.Pins = PINC & RECORD_PIN_MASK;
+
+			RecordHead = RecordTail = 0;
+			RecordDropped = 0;
+			PCIFR = (1<<PCIF1);
+			PCMSK1 |= RECORD_PIN_MASK;
+			PCICR |= (1<<PCIE1);
+		}
+		return;
+	}
+
+	recordEdges(state);
+
+	if ((Recorder.WasReleased && state->IsPressed_StartButton) || recordIsFull())
+	{
+		// a second press of the start button ends the recording, so does a full profile slot
+		finishRecording(state);
+	}
+}
+
+void recordEdges(struct State *state)
+{
+	unsigned char changed, s;
+	unsigned long ticks;
+
+	while (RecordTail != RecordHead)
+	{
+		// the loop drains the buffer on every pass, so every stamp is within half a TCNT1 rollover (4 ms) of the
+		// last count and can be placed on the Ticks timeline with a signed 16-bit difference.  Edges that came in
+		// after getClockTime() read TCNT1 come out slightly ahead of Ticks, which is fine
+		ticks = state->Ticks + (int16_t)(RecordBuffer[RecordTail].Stamp - state->LastCount);
+		changed = (RecordBuffer[RecordTail].Pins ^ Recorder.Pins) & RECORD_PIN_MASK;
+		Recorder.Pins = RecordBuffer[RecordTail].Pins;
+		RecordTail = (RecordTail + 1) & (RECORD_BUFFER_SIZE - 1);
+
+		for (s = 0; s < PINS_TOUCH_COUNT; s++)
+		{
+			if (!(changed & (1<<s)))
+			{
+				continue;
+			}
+
+			if (!(Recorder.Pins & (1<<s)))
+			{
+				// pressed (active low)
+				Recorder.PressTicks[s] = ticks;
+			}
+			else
+			{
+				recordStep(state, s, Recorder.PressTicks[s], ticks);
+			}
+		}
+	}
+}
+
+void recordStep(struct State *state, unsigned char touch, unsigned long pressTicks, unsigned long releaseTicks)
+{
+	unsigned long offset = (pressTicks - state->StartTime) / TICKS_PER_US;
+	unsigned long duration = (releaseTicks - pressTicks) / TICKS_PER_US;
+	step tmp;
+
+	// Ticks wrap after about nine minutes at 8 MHz, which is as long as a recording can be
+	if (duration < MS(RECORD_MIN_MS) || !recordFits(touch) || offset + duration > STEP_MAX_US)
+	{
+		return;
+	}
+
+	tmp = createTouch(offset, duration);
+	if (Recorder.Head[touch] == NULL)
+	{
+		Recorder.Head[touch] = tmp;
+	}
+	else
+	{
+		Recorder.Tail[touch]->Next = tmp;
+	}
+	Recorder.Tail[touch] = tmp;
+	Recorder.Count++;
+}
+
+// one more step on touch fits in the profile slot, next to the placeholders the other empty touches are saved with
+bool recordFits(unsigned char touch)
+{
+	unsigned char s, needed = Recorder.Count + 1;
+
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		if (s != touch && Recorder.Head[s] == NULL)
+		{
+			needed++;
+		}
+	}
+	return needed <= PROFILE_MAX_STEPS;
+}
+
+// not one more step fits on any touch
+bool recordIsFull(void)
+{
+	unsigned char s;
+
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		if (recordFits(s))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void finishRecording(struct State *state)
+{
+	unsigned char slot, s;
+	bool isSaved;
+
+	PCICR &= ~(1<<PCIE1);
+	PCMSK1 &= ~RECORD_PIN_MASK;
+	recordEdges(state);
+	Recorder.Dropped = RecordDropped;
+
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		if (!(Recorder.Pins & (1<<s)))
+		{
+			// still held when the recording was stopped
+			recordStep(state, s, Recorder.PressTicks[s], state->Ticks);
+		}
+
+		freeSteps(state->TouchDefault[s]);
+		// the sequencer expects every touch to have at least one step, zero duration steps are placeholders
+		state->TouchDefault[s] = Recorder.Head[s] != NULL ? Recorder.Head[s] : createTouch(0, 0);
+		// the recorded edges were the driver's own, replay them as they are
+		state->ProfileTrim_Touch[s] = 0;
+	}
+
+	// the recording goes into the first empty user slot, or over the last one when they are all taken
+	for (slot = BuiltinProfileCount; slot < PROFILE_SLOT_COUNT - 1 && isProfileSlotValid(slot); slot++);
+
+	isSaved = saveProfileSlot(state, slot);
+	state->IsRecording = false;
+	if (!isSaved)
+	{
+		// the profile that was active before is still the one in EEPROM
+		loadProfile(state, state->Profile);
+#if CONF_SHELL_ENABLED
+		uartPutString_P(PSTR("recording not saved, profile "));
+		uartPutLong(state->Profile);
+		uartPutString_P(PSTR(" kept\r\n"));
+		shellPrompt();
+#endif
+		return;
+	}
+	state->Profile = slot;
+	eeprom_update_byte(&ActiveProfile, slot);
+	armRun(state);
+
+#if CONF_SHELL_ENABLED
+	uartPutString_P(PSTR("recorded "));
+	uartPutLong(Recorder.Count);
+	uartPutString_P(PSTR(" steps into profile "));
+	uartPutLong(slot);
+	if (Recorder.Dropped > 0)
+	{
+		uartPutString_P(PSTR(", dropped edges "));
+		uartPutLong(Recorder.Dropped);
+	}
+	uartPutNewLine();
+	shellPrompt();
+#endif
+}
+
+ISR(PCINT1_vect)
+{
+	unsigned int stamp = TCNT1;
+	unsigned char next = (RecordHead + 1) & (RECORD_BUFFER_SIZE - 1);
+
+	if (next == RecordTail)
+	{
+		RecordDropped++;
+		return;
+	}
+
+	RecordBuffer[RecordHead].Stamp = stamp;
+	RecordBuffer[RecordHead].Pins = PINC;
+	RecordHead = next;
+}
+
+#endif /* RECORD_H_ */
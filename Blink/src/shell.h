@@ -0,0 +1,631 @@
+/*
+ * shell.h
+ *
+ * Created: 10/18/2026 10:05:46 AM
+ *  Author: odinh
+ */
+
+
+#ifndef SHELL_H_
+#define SHELL_H_
+
+// line based tuning shell on USART0.  shellPoll() is called from runBackground() which only runs while
+// the sequencer is idle, and it consumes at most one character per loop so a run is never held up by parsing
+#define SHELL_LINE_SIZE 32
+#define SHELL_MAX_ARGS 3
+
+char ShellLine[SHELL_LINE_SIZE];
+unsigned char ShellLength;
+
+// prototypes
+void shellInitialize(void);
+void shellPoll(struct State *state);
+void shellExecute(struct State *state, char *line);
+void shellPrompt(void);
+void shellList(struct State *state);
+void shellShow(struct State *state);
+void shellNudge(struct State *state, long *args, unsigned char argCount, bool isOffset);
+void shellRpm(struct State *state, long *args, unsigned char argCount);
+void shellDetector(struct State *state, long *args, unsigned char argCount);
+void shellTarget(struct State *state, long *args, unsigned char argCount);
+void shellStats(struct State *state);
+void shellTrim(struct State *state, long *args, unsigned char argCount, bool isProfile);
+void shellCalibrate(void);
+void shellResets(void);
+char* shellParseLong(char *s, long *value);
+void shellPutMS(unsigned long us);
+step getStep(struct State *state, int touch, int index);
+
+void shellInitialize(void)
+{
+	ShellLength = 0;
+	uartInitialize(CONF_UART_BAUD);
+	uartAttach();
+	shellPrompt();
+}
+
+void shellPoll(struct State *state)
+{
+	char c;
+
+	if (!uartGetChar(&c))
+	{
+		return;
+	}
+
+	if (c == '\r' || c == '\n')
+	{
+		if (ShellLength > 0)
+		{
+			uartPutNewLine();
+			ShellLine[ShellLength] = 0;
+			ShellLength = 0;
+			shellExecute(state, ShellLine);
+			if (state->IsRunning || state->IsRecording)
+			{
+				// a dry run or a recording prints its own prompt when it finishes
+				return;
+			}
+			// the command may have changed the steps, runBackground() arms again
+			state->IsArmed = false;
+#if CONF_START_INTERRUPT
+			setPressOutputs(0);
+#endif
+			shellPrompt();
+		}
+	}
+	else if (c == '\b' || c == 0x7F)
+	{
+		if (ShellLength > 0)
+		{
+			ShellLength--;
+			uartPutString_P(PSTR("\b \b"));
+		}
+	}
+	else if (ShellLength < SHELL_LINE_SIZE - 1)
+	{
+		ShellLine[ShellLength++] = c;
+		uartPutChar(c);
+	}
+}
+
+void shellExecute(struct State *state, char *line)
+{
+	char *command = line;
+	char *p = line;
+	long args[SHELL_MAX_ARGS];
+	unsigned char argCount = 0;
+
+	// split the command word from its numeric arguments
+	while (*p && *p != ' ')
+	{
+		p++;
+	}
+	if (*p)
+	{
+		*p++ = 0;
+	}
+	while (argCount < SHELL_MAX_ARGS && (p = shellParseLong(p, &args[argCount])) != NULL)
+	{
+		argCount++;
+	}
+
+	if (strcmp_P(command, PSTR("help")) == 0)
+	{
+		uartPutString_P(PSTR(
+			"list                      list profiles\r\n"
+			"use <p>                   select profile p\r\n"
+			"show                      show the steps of the active profile\r\n"
+			"offset <t> <s> <+/-us>    nudge the offset of step s of touch t\r\n"
+			"duration <t> <s> <+/-us>  nudge the duration of step s of touch t\r\n"
+			"rpm <t> <s> <rpm>         start step s of touch t at rpm (0 for time only)\r\n"
+			"adc <t> <s> <d>           start step s of touch t on analog detector d (0 for time only)\r\n"
+			"target <s> <rpm>          learn the offset of shift s towards rpm (0 to stop learning)\r\n"
+			"trim <t> <ms>             fire every step of touch t earlier by ms (all profiles)\r\n"
+			"ptrim <t> <ms>            trim touch t for the active profile only (-1 for the default)\r\n"
+			"dry                       run the sequence without driving the touch outputs\r\n"
+			"stats                     show run statistics\r\n"
+			"save                      commit the active profile to EEPROM\r\n"
+			"record                    capture a launch from the record inputs into a new profile\r\n"
+			"revert                    drop the EEPROM copy and reload the built-in sequence\r\n"
+			"cal                       calibrate the oscillator for the current temperature\r\n"
+			"resets                    list the logged watchdog, brown-out and external resets\r\n"));
+	}
+	else if (strcmp_P(command, PSTR("list")) == 0)
+	{
+		shellList(state);
+	}
+	else if (strcmp_P(command, PSTR("use")) == 0 && argCount == 1 && args[0] >= 0 && args[0] < PROFILE_SLOT_COUNT)
+	{
+		loadProfile(state, args[0]);
+		shellList(state);
+	}
+	else if (strcmp_P(command, PSTR("show")) == 0)
+	{
+		shellShow(state);
+	}
+	else if (strcmp_P(command, PSTR("offset")) == 0)
+	{
+		shellNudge(state, args, argCount, true);
+	}
+	else if (strcmp_P(command, PSTR("duration")) == 0)
+	{
+		shellNudge(state, args, argCount, false);
+	}
+	else if (strcmp_P(command, PSTR("rpm")) == 0)
+	{
+		shellRpm(state, args, argCount);
+	}
+	else if (strcmp_P(command, PSTR("adc")) == 0)
+	{
+		shellDetector(state, args, argCount);
+	}
+	else if (strcmp_P(command, PSTR("target")) == 0)
+	{
+		shellTarget(state, args, argCount);
+	}
+#if CONF_TRIM_ENABLED
+	else if (strcmp_P(command, PSTR("trim")) == 0)
+	{
+		shellTrim(state, args, argCount, false);
+	}
+	else if (strcmp_P(command, PSTR("ptrim")) == 0)
+	{
+		shellTrim(state, args, argCount, true);
+	}
+#endif
+	else if (strcmp_P(command, PSTR("dry")) == 0)
+	{
+		state->IsDryRun = true;
+		startRun(state);
+	}
+	else if (strcmp_P(command, PSTR("stats")) == 0)
+	{
+		shellStats(state);
+	}
+	else if (strcmp_P(command, PSTR("save")) == 0)
+	{
+		uartPutString_P(saveProfileSlot(state, state->Profile) ? PSTR("saved\r\n") : PSTR("too many steps\r\n"));
+	}
+#if CONF_RECORD_ENABLED
+	else if (strcmp_P(command, PSTR("record")) == 0)
+	{
+		uartPutString_P(PSTR("press start to begin, press again to finish\r\n"));
+		startRecording(state);
+	}
+#endif
+	else if (strcmp_P(command, PSTR("revert")) == 0)
+	{
+		eraseProfileSlot(state->Profile);
+		loadProfile(state, state->Profile);
+		shellShow(state);
+	}
+#if CONF_OSCCAL_ENABLED
+	else if (strcmp_P(command, PSTR("cal")) == 0)
+	{
+		shellCalibrate();
+	}
+#endif
+	else if (strcmp_P(command, PSTR("resets")) == 0)
+	{
+		shellResets();
+	}
+	else
+	{
+		uartPutString_P(PSTR("? (help)\r\n"));
+	}
+}
+
+void shellPrompt(void)
+{
+	uartPutString_P(PSTR("> "));
+}
+
+void shellList(struct State *state)
+{
+	unsigned char p;
+
+	for (p = 0; p < PROFILE_SLOT_COUNT; p++)
+	{
+		uartPutChar(p == state->Profile ? '*' : ' ');
+		uartPutLong(p);
+		uartPutChar(' ');
+		if (isBuiltinProfile(p))
+		{
+			uartPutString_P(Profiles[p].Name);
+		}
+		else
+		{
+			uartPutString_P(PSTR("user"));
+		}
+		uartPutString_P(isProfileSlotValid(p) ? PSTR(" (eeprom)") : isBuiltinProfile(p) ? PSTR(" (flash)") : PSTR(" (empty)"));
+		uartPutNewLine();
+	}
+}
+
+void shellShow(struct State *state)
+{
+	step current;
+	int s, i;
+
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		for (current = state->TouchDefault[s], i = 0; current != NULL; current = current->Next, i++)
+		{
+			uartPutLong(s);
+			uartPutChar(' ');
+			uartPutLong(i);
+			uartPutString_P(PSTR(" offset "));
+			shellPutMS(current->Offset);
+			uartPutString_P(PSTR(" duration "));
+			shellPutMS(current->Duration);
+			if (current->Rpm > 0)
+			{
+				uartPutString_P(PSTR(" rpm "));
+				uartPutLong(current->Rpm);
+			}
+			if (current->Detector > 0)
+			{
+				uartPutString_P(PSTR(" adc "));
+				uartPutLong(current->Detector);
+			}
+			if (current->TargetRpm > 0)
+			{
+				uartPutString_P(PSTR(" target "));
+				uartPutLong(current->TargetRpm);
+			}
+			uartPutNewLine();
+		}
+	}
+
+#if CONF_TRIM_ENABLED
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		uartPutString_P(PSTR("trim "));
+		uartPutLong(s);
+		uartPutChar(' ');
+		uartPutLong(getTrim(state, s));
+		uartPutString_P(state->ProfileTrim_Touch[s] != TRIM_NONE ? PSTR(" (profile)\r\n") : PSTR(" (default)\r\n"));
+	}
+#endif
+}
+
+void shellNudge(struct State *state, long *args, unsigned char argCount, bool isOffset)
+{
+	step target = NULL;
+	long value;
+
+	if (argCount == 3)
+	{
+		target = getStep(state, args[0], args[1]);
+	}
+
+	if (target == NULL)
+	{
+		uartPutString_P(PSTR("no such step\r\n"));
+		return;
+	}
+
+	value = (long)(isOffset ? target->Offset : target->Duration) + args[2]; // microseconds, the step timeline resolution
+	if (value < 0 || (unsigned long)value + (isOffset ? target->Duration : target->Offset) > STEP_MAX_US)
+	{
+		uartPutString_P(PSTR("out of range\r\n"));
+		return;
+	}
+
+	if (isOffset)
+	{
+		target->Offset = value;
+	}
+	else
+	{
+		target->Duration = value;
+	}
+
+	shellPutMS(target->Offset);
+	uartPutChar(' ');
+	shellPutMS(target->Duration);
+	uartPutNewLine();
+}
+
+void shellRpm(struct State *state, long *args, unsigned char argCount)
+{
+	step target = NULL;
+
+	if (argCount == 3)
+	{
+		target = getStep(state, args[0], args[1]);
+	}
+
+	if (target == NULL)
+	{
+		uartPutString_P(PSTR("no such step\r\n"));
+		return;
+	}
+	if (args[2] < 0 || args[2] > CONF_TACH_MAX_RPM)
+	{
+		uartPutString_P(PSTR("out of range\r\n"));
+		return;
+	}
+
+	target->Rpm = args[2];
+}
+
+void shellDetector(struct State *state, long *args, unsigned char argCount)
+{
+	step target = NULL;
+
+	if (argCount == 3)
+	{
+		target = getStep(state, args[0], args[1]);
+	}
+
+	if (target == NULL)
+	{
+		uartPutString_P(PSTR("no such step\r\n"));
+		return;
+	}
+	if (args[2] < 0 || args[2] > DetectorCount)
+	{
+		uartPutString_P(PSTR("out of range\r\n"));
+		return;
+	}
+
+	target->Detector = args[2];
+}
+
+void shellTarget(struct State *state, long *args, unsigned char argCount)
+{
+	step target = NULL;
+
+	if (argCount == 2)
+	{
+		target = getStep(state, ADAPT_TOUCH, args[0]);
+	}
+
+	if (target == NULL)
+	{
+		uartPutString_P(PSTR("no such step\r\n"));
+		return;
+	}
+	if (args[1] < 0 || args[1] > CONF_TACH_MAX_RPM)
+	{
+		uartPutString_P(PSTR("out of range\r\n"));
+		return;
+	}
+
+	target->TargetRpm = args[1];
+}
+
+void shellTrim(struct State *state, long *args, unsigned char argCount, bool isProfile)
+{
+	if (argCount != 2 || args[0] < 0 || args[0] >= PINS_TOUCH_COUNT)
+	{
+		uartPutString_P(PSTR("no such touch\r\n"));
+		return;
+	}
+	if (args[1] < (isProfile ? -1 : 0) || args[1] > TRIM_MAX_MS)
+	{
+		uartPutString_P(PSTR("out of range\r\n"));
+		return;
+	}
+
+	if (isProfile)
+	{
+		// kept with the profile by save
+		state->ProfileTrim_Touch[args[0]] = args[1] < 0 ? TRIM_NONE : args[1];
+	}
+	else
+	{
+		setDefaultTrim(args[0], args[1]);
+	}
+
+	uartPutLong(getTrim(state, args[0]));
+	uartPutNewLine();
+}
+
+void shellStats(struct State *state)
+{
+#if CONF_ADC_ENABLED || CONF_BENCH_ENABLED
+	unsigned char i;
+#endif
+
+	uartPutString_P(PSTR("runs "));
+	uartPutLong(state->Stats.RunCount);
+	uartPutString_P(PSTR("\r\nlast run ms "));
+	uartPutLong(state->Stats.LastRunMS);
+	uartPutString_P(PSTR("\r\nlast run loops "));
+	uartPutLong(state->Stats.LastRunLoops);
+	uartPutString_P(PSTR("\r\nmax loop ticks "));
+	uartPutLong(state->Stats.MaxLoopTicks);
+#if CONF_TICK_ENABLED
+	uartPutString_P(PSTR("\r\nmax tick work us "));
+	uartPutLong(state->Stats.MaxTickWork / TICK_COUNTS_PER_US);
+	uartPutString_P(PSTR("\r\ntick overruns "));
+	uartPutLong(state->Stats.TickOverruns);
+#endif
+#if CONF_BENCH_ENABLED
+	uartPutString_P(PSTR("\r\nbench " BENCH_CONFIG));
+	for (i = 0; i < PINS_TOUCH_COUNT; i++)
+	{
+		// cycles late against the schedule, last and worst
+		uartPutString_P(PSTR("\r\ntouch "));
+		uartPutLong(i);
+		uartPutString_P(PSTR(" press to edge cycles "));
+		uartPutLong(state->Stats.EdgeLateTicks[i]);
+		uartPutString_P(PSTR(" max "));
+		uartPutLong(state->Stats.MaxEdgeLateTicks[i]);
+	}
+	if (state->Stats.IsLastWakeFromPowerDown)
+	{
+		uartPutString_P(PSTR("\r\nlast press woke from power-down, add the oscillator start-up"));
+	}
+#endif
+#if CONF_TACH_ENABLED
+	uartPutString_P(PSTR("\r\nrpm "));
+	uartPutLong(getTachRpm());
+#endif
+#if CONF_ADC_ENABLED
+	for (i = 0; i < DetectorCount; i++)
+	{
+		uartPutString_P(PSTR("\r\nadc "));
+		uartPutLong(i + 1);
+		uartPutChar(' ');
+		uartPutLong(AdcLatest[Detectors[i].Input]);
+		uartPutString_P(Detectors[i].IsOn ? PSTR(" on") : PSTR(" off"));
+	}
+#endif
+#if CONF_OSCCAL_ENABLED
+	uartPutString_P(PSTR("\r\nosccal "));
+	uartPutLong(OSCCAL);
+	uartPutString_P(PSTR("\r\ntemperature "));
+	uartPutLong(OsccalTemperature);
+#endif
+	uartPutNewLine();
+}
+
+void shellCalibrate(void)
+{
+	bool isCalibrated;
+#if !CONF_OSCCAL_CRYSTAL
+	char c;
+#endif
+
+#if CONF_WATCHDOG_ENABLED
+	// the calibration blocks for seconds
+	watchdogPause();
+#endif
+#if CONF_OSCCAL_CRYSTAL
+	isCalibrated = osccalCalibrate();
+#if CONF_TICK_ENABLED
+	// the crystal borrowed Timer2
+	initializeTick();
+#endif
+#if CONF_WAVE_ENABLED && WAVE_USES_TIMER2
+	initializeWave();
+#endif
+#else
+	uartPutString_P(PSTR("send U until done\r\n"));
+	uartFlush();
+	isCalibrated = osccalCalibrate();
+	// the reference characters are not commands
+	while (uartGetChar(&c))
+	{
+	}
+#endif
+#if CONF_WATCHDOG_ENABLED
+	watchdogResume();
+#endif
+	if (isCalibrated)
+	{
+		uartPutString_P(PSTR("osccal "));
+		uartPutLong(OSCCAL);
+		uartPutNewLine();
+	}
+	else
+	{
+		uartPutString_P(PSTR("no reference\r\n"));
+	}
+}
+
+// newest first
+void shellResets(void)
+{
+	struct ResetEntry entry;
+	unsigned char next, i;
+
+	next = eeprom_read_byte(&ResetLog.Next);
+	if (next >= WATCHDOG_LOG_SIZE)
+	{
+		next = 0;
+	}
+	for (i = 1; i <= WATCHDOG_LOG_SIZE; i++)
+	{
+		eeprom_read_block(&entry, &ResetLog.Entry[(next + WATCHDOG_LOG_SIZE - i) % WATCHDOG_LOG_SIZE], sizeof(struct ResetEntry));
+		if (entry.Cause == 0xFF)
+		{
+			continue;
+		}
+		uartPutString_P((entry.Cause & (1<<WDRF)) ? PSTR("watchdog") : (entry.Cause & (1<<BORF)) ? PSTR("brown-out") : PSTR("external"));
+		if (entry.Context == WATCHDOG_UNKNOWN)
+		{
+			uartPutString_P(PSTR(" ?"));
+		}
+		else
+		{
+			if (entry.Context & WATCHDOG_FAULT)
+			{
+				uartPutString_P(PSTR(" fault"));
+			}
+			if (entry.Context & WATCHDOG_RUNNING)
+			{
+				uartPutString_P(PSTR(" running ms "));
+				uartPutLong(entry.RunMS);
+			}
+			else
+			{
+				uartPutString_P((entry.Context & WATCHDOG_RECORDING) ? PSTR(" recording") : PSTR(" idle"));
+			}
+		}
+		uartPutNewLine();
+	}
+}
+
+char* shellParseLong(char *s, long *value)
+{
+	bool isNegative = false;
+	long result = 0;
+
+	while (*s == ' ')
+	{
+		s++;
+	}
+	if (*s == '-' || *s == '+')
+	{
+		isNegative = *s++ == '-';
+	}
+	if (*s < '0' || *s > '9')
+	{
+		return NULL;
+	}
+	while (*s >= '0' && *s <= '9')
+	{
+		result = result * 10 + (*s++ - '0');
+	}
+
+	*value = isNegative ? -result : result;
+	return s;
+}
+
+// step times are microseconds, the shell shows milliseconds with the fraction only when there is one
+void shellPutMS(unsigned long us)
+{
+	unsigned int fraction = us % 1000;
+
+	uartPutLong(us / 1000);
+	if (fraction > 0)
+	{
+		uartPutChar('.');
+		uartPutChar('0' + fraction / 100);
+		uartPutChar('0' + fraction / 10 % 10);
+		uartPutChar('0' + fraction % 10);
+	}
+}
+
+step getStep(struct State *state, int touch, int index)
+{
+	step current;
+
+	if (touch < 0 || touch >= PINS_TOUCH_COUNT)
+	{
+		return NULL;
+	}
+
+	for (current = state->TouchDefault[touch]; current != NULL && index > 0; current = current->Next)
+	{
+		index--;
+	}
+	return index == 0 ? current : NULL;
+}
+
+#endif /* SHELL_H_ */
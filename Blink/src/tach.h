@@ -0,0 +1,110 @@
+/*
+ * tach.h
+ *
+ * Created: 10/18/2026 3:02:40 PM
+ *  Author: odinh
+ */
+
+
+#ifndef TACH_H_
+#define TACH_H_
+
+// tach input on INT1 (PD3).  Every falling edge stamps Timer1 (extended to 32 bits by the overflow interrupt)
+// and publishes the pulse period.  Rpm steps never divide per pulse - the rpm threshold is turned into a
+// period once when the step becomes current (rpmToPeriod) and the sequencer only compares periods
+#define TACH_RPM_CONSTANT (60UL * TIMEBASE_HZ / CONF_TACH_PULSES_PER_REV) // rpm = TACH_RPM_CONSTANT / period (ticks)
+#define TACH_MIN_PERIOD (TACH_RPM_CONSTANT / CONF_TACH_MAX_RPM) // anything shorter is noise
+#define TACH_NO_SIGNAL 0xFFFFFFFFUL
+#define TACH_REARM_SHIFT 4 // an rpm step is re-armed once the period is 1/16 (about 6% rpm) above its trigger period
+
+volatile unsigned int Timer1Overflows;
+volatile unsigned long TachLastStamp;
+volatile unsigned long TachPeriod;
+
+// prototypes
+void initializeTach(void);
+unsigned long getTimer1Stamp(void);
+unsigned long getTachPeriod(void);
+unsigned int getTachRpm(void);
+
+void initializeTach(void)
+{
+	Timer1Overflows = 0;
+	TachLastStamp = 0;
+	TachPeriod = TACH_NO_SIGNAL;
+
+	DDRD &= ~(1<<DDD3);
+	PORTD |= (1<<PIND3); // pull-up for an open collector tach signal
+	EICRA = (EICRA & ~((1<<ISC11) | (1<<ISC10))) | (1<<ISC11); // falling edge
+	EIFR = (1<<INTF1);
+	EIMSK |= (1<<INT1);
+	TIMSK1 |= (1<<TOIE1);
+}
+
+// raw Timer1 count extended to 32 bits, call with interrupts disabled
+unsigned long getTimer1Count(void)
+{
+	unsigned int count = TCNT1;
+	unsigned int overflows = Timer1Overflows;
+
+	// an overflow that is pending but not yet serviced belongs to this count if the count has already wrapped
+	if ((TIFR1 & (1<<TOV1)) && count < 0x8000)
+	{
+		overflows++;
+	}
+	return ((unsigned long)overflows << 16) | count;
+}
+
+// Timer1 count in full speed ticks whatever the system clock prescaler, call with interrupts disabled
+unsigned long getTimer1Stamp(void)
+{
+	return clockNormalize(getTimer1Count());
+}
+
+// the latest pulse period in ticks.  If the tach has gone quiet for longer than that, the time since the last
+// pulse is used instead, so a dying engine never looks faster than it is
+unsigned long getTachPeriod(void)
+{
+	unsigned long period, age;
+	irqflags_t flags = cpu_irq_save();
+
+	period = TachPeriod;
+	age = getTimer1Stamp() - TachLastStamp;
+	cpu_irq_restore(flags);
+
+	return age > period ? age : period;
+}
+
+// rpm for display, this one does divide
+unsigned int getTachRpm(void)
+{
+	unsigned long period = getTachPeriod();
+
+	return period >= TACH_RPM_CONSTANT ? 0 : TACH_RPM_CONSTANT / period;
+}
+
+unsigned long rpmToPeriod(unsigned int rpm)
+{
+	return TACH_RPM_CONSTANT / rpm;
+}
+
+ISR(INT1_vect)
+{
+	unsigned long stamp = getTimer1Stamp();
+	unsigned long period = stamp - TachLastStamp;
+
+	if (period < TACH_MIN_PERIOD)
+	{
+		return;
+	}
+
+	TachPeriod = period;
+	TachLastStamp = stamp;
+}
+
+ISR(TIMER1_OVF_vect)
+{
+	Timer1Overflows++;
+}
+
+#endif /* TACH_H_ */
@@ -0,0 +1,88 @@
+/*
+ * tick.h
+ *
+ * Created: 10/19/2026 8:45:21 AM
+ *  Author: odinh
+ */
+
+
+#ifndef TICK_H_
+#define TICK_H_
+
+// time triggered execution.  Timer2 in CTC mode fires every CONF_TICK_US, the CPU idles between ticks and
+// every tick makes exactly one pass through run().  Timer2 counts microseconds (8 MHz / 8), so TCNT2 right
+// after run() returns is the work done in that tick, and a tick count that moved on during run() means a tick was missed
+#define TICK_COUNTS_PER_US (F_CPU / 8 / 1000000UL)
+#define TICK_TOP (CONF_TICK_US * TICK_COUNTS_PER_US - 1)
+
+#if TICK_TOP > 255
+#error "CONF_TICK_US does not fit in Timer2 with a /8 prescaler"
+#endif
+
+volatile unsigned char TickCount;
+unsigned char TickLast; // the tick the current pass belongs to
+
+// prototypes
+void initializeTick(void);
+void waitForTick(void);
+void measureTick(struct State *state);
+
+void initializeTick(void)
+{
+	TCCR2A = (1<<WGM21); // CTC, TOP = OCR2A
+	TCCR2B = (1<<CS21); // /8
+	OCR2A = TICK_TOP;
+	TCNT2 = 0;
+	TIFR2 = (1<<OCF2A);
+	TIMSK2 |= (1<<OCIE2A);
+	TickLast = TickCount;
+	set_sleep_mode(SLEEP_MODE_IDLE);
+}
+
+void waitForTick(void)
+{
+	// other interrupts (USART, ADC, tach) wake the CPU too, so go back to sleep until the tick moves on
+	while (TickCount == TickLast)
+	{
+		cli();
+		if (TickCount == TickLast)
+		{
+			sleep_enable();
+			// sei() always lets the next instruction run first, so the compare match can not slip in between
+			sei();
+			sleep_cpu();
+			sleep_disable();
+		}
+		sei();
+	}
+	TickLast = TickCount;
+}
+
+// called right after run() in tick mode
+void measureTick(struct State *state)
+{
+	unsigned char work = TCNT2;
+
+	if (!state->IsRunning)
+	{
+		// idle ticks run the background work and are allowed to stretch
+		return;
+	}
+
+	if (TickCount != TickLast)
+	{
+		// the next compare match already happened while run() was busy
+		state->Stats.TickOverruns++;
+	}
+	else if (work > state->Stats.MaxTickWork)
+	{
+		state->Stats.MaxTickWork = work;
+	}
+}
+
+ISR(TIMER2_COMPA_vect)
+{
+	TickCount++;
+}
+
+#endif /* TICK_H_ */
@@ -0,0 +1,57 @@
+/*
+ * trim.h
+ *
+ * Created: 10/19/2026 4:48:20 PM
+ *  Author: odinh
+ */
+
+
+#ifndef TRIM_H_
+#define TRIM_H_
+
+// actuator latency trims.  The start pedal, the shift paddle and the NO2 button each take their own time from
+// the pin edge to the car doing something, so every touch output has a trim (ms) that armRun() takes off the
+// start time of each of its steps as it builds the schedule - the whole step moves earlier and the car acts at
+// the step's offset.
+// Every channel has a default kept in EEPROM, and a profile can carry its own trims that win over the defaults
+#define TRIM_NONE 0xFFFF // profile trim that follows the channel default
+#define TRIM_MAX_MS 1000
+
+EEMEM uint16_t ChannelTrims[PINS_TOUCH_COUNT];
+
+unsigned int DefaultTrims[PINS_TOUCH_COUNT];
+const unsigned int ConfTrims[PINS_TOUCH_COUNT] = CONF_TRIM_DEFAULTS;
+
+// prototypes
+void initializeTrim(void);
+unsigned int getTrim(struct State *state, int s);
+void setDefaultTrim(int s, unsigned int ms);
+
+void initializeTrim(void)
+{
+	int s;
+
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		// erased EEPROM reads back as 0xFFFF
+		DefaultTrims[s] = eeprom_read_word(&ChannelTrims[s]);
+		if (DefaultTrims[s] > TRIM_MAX_MS)
+		{
+			DefaultTrims[s] = ConfTrims[s];
+		}
+	}
+}
+
+// the trim of touch s for the active profile (ms)
+unsigned int getTrim(struct State *state, int s)
+{
+	return state->ProfileTrim_Touch[s] != TRIM_NONE ? state->ProfileTrim_Touch[s] : DefaultTrims[s];
+}
+
+void setDefaultTrim(int s, unsigned int ms)
+{
+	DefaultTrims[s] = ms;
+	eeprom_update_word(&ChannelTrims[s], ms);
+}
+
+#endif /* TRIM_H_ */
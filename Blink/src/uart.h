@@ -0,0 +1,175 @@
+/*
+ * uart.h
+ *
+ * Created: 10/18/2026 9:20:31 AM
+ *  Author: odinh
+ */
+
+
+#ifndef UART_H_
+#define UART_H_
+
+// both buffers must be a power of two so the indexes can wrap with a mask
+#define UART_RX_BUFFER_SIZE 32
+#define UART_TX_BUFFER_SIZE 64
+
+volatile unsigned char UartRxBuffer[UART_RX_BUFFER_SIZE];
+volatile unsigned char UartRxHead;
+volatile unsigned char UartRxTail;
+volatile unsigned char UartTxBuffer[UART_TX_BUFFER_SIZE];
+volatile unsigned char UartTxHead;
+volatile unsigned char UartTxTail;
+
+// prototypes
+void uartInitialize(unsigned long baud);
+void uartAttach(void);
+void uartDetach(void);
+bool uartGetChar(char *c);
+void uartPutChar(char c);
+void uartPutString(const char *s);
+void uartPutString_P(const char *s);
+void uartPutLong(long value);
+void uartPutNewLine(void);
+void uartFlush(void);
+
+void uartInitialize(unsigned long baud)
+{
+	// double speed mode gives a usable divisor for 38400 baud at 8 MHz (0.2% error)
+	UBRR0 = (unsigned int)((F_CPU / (8UL * baud)) - 1);
+	UCSR0A = (1<<U2X0);
+	UCSR0C = (1<<UCSZ01) | (1<<UCSZ00); // 8N1
+	UartRxHead = UartRxTail = 0;
+	UartTxHead = UartTxTail = 0;
+}
+
+void uartAttach(void)
+{
+	// the receiver and transmitter override the port settings of PD0 and PD1
+	UCSR0B = (1<<RXEN0) | (1<<TXEN0) | (1<<RXCIE0);
+}
+
+void uartDetach(void)
+{
+	// hand PD0 and PD1 back to PORTD, anything still waiting to be sent is dropped
+	UCSR0B = 0;
+	UartTxTail = UartTxHead;
+}
+
+bool uartGetChar(char *c)
+{
+	if (UartRxHead == UartRxTail)
+	{
+		return false;
+	}
+
+	*c = UartRxBuffer[UartRxTail];
+	UartRxTail = (UartRxTail + 1) & (UART_RX_BUFFER_SIZE - 1);
+	return true;
+}
+
+void uartPutChar(char c)
+{
+	unsigned char next = (UartTxHead + 1) & (UART_TX_BUFFER_SIZE - 1);
+
+	if (!(UCSR0B & (1<<TXEN0)))
+	{
+		// detached, nobody is listening
+		return;
+	}
+
+	// the shell only prints while idle, so it is ok to wait for room in the buffer
+	while (next == UartTxTail);
+
+	UartTxBuffer[UartTxHead] = c;
+	UartTxHead = next;
+	UCSR0B |= (1<<UDRIE0);
+}
+
+void uartPutString(const char *s)
+{
+	while (*s)
+	{
+		uartPutChar(*s++);
+	}
+}
+
+void uartPutString_P(const char *s)
+{
+	char c;
+
+	while ((c = pgm_read_byte(s++)))
+	{
+		uartPutChar(c);
+	}
+}
+
+void uartPutLong(long value)
+{
+	char digits[11];
+	unsigned char length = 0;
+	unsigned long magnitude = value;
+
+	if (value < 0)
+	{
+		uartPutChar('-');
+		magnitude = 0UL - (unsigned long)value;
+	}
+
+	do
+	{
+		digits[length++] = '0' + (magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude > 0);
+
+	while (length > 0)
+	{
+		uartPutChar(digits[--length]);
+	}
+}
+
+void uartPutNewLine(void)
+{
+	uartPutChar('\r');
+	uartPutChar('\n');
+}
+
+// wait until the last character has left the shift register
+void uartFlush(void)
+{
+	if (!(UCSR0B & (1<<TXEN0)))
+	{
+		return;
+	}
+
+	while (UartTxHead != UartTxTail);
+	while (!(UCSR0A & (1<<UDRE0)));
+	while (!(UCSR0A & (1<<TXC0)));
+}
+
+ISR(USART_RX_vect)
+{
+	unsigned char c = UDR0;
+	unsigned char next = (UartRxHead + 1) & (UART_RX_BUFFER_SIZE - 1);
+
+	// drop the character if the shell has fallen behind
+	if (next != UartRxTail)
+	{
+		UartRxBuffer[UartRxHead] = c;
+		UartRxHead = next;
+	}
+}
+
+ISR(USART_UDRE_vect)
+{
+	if (UartTxHead == UartTxTail)
+	{
+		UCSR0B &= ~(1<<UDRIE0);
+		return;
+	}
+
+	UCSR0A |= (1<<TXC0); // cleared by writing a one, so TXC0 only shows the end of this character
+	UDR0 = UartTxBuffer[UartTxTail];
+	UartTxTail = (UartTxTail + 1) & (UART_TX_BUFFER_SIZE - 1);
+}
+
+#endif /* UART_H_ */
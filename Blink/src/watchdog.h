@@ -0,0 +1,220 @@
+/*
+ * watchdog.h
+ *
+ * Created: 10/20/2026 2:41:08 PM
+ *  Author: odinh
+ */
+
+
+#ifndef WATCHDOG_H_
+#define WATCHDOG_H_
+
+// watchdog fail-safe.  The watchdog is only fed from main after a pass through run() that moved the clock on, so
+// a hang anywhere - a stuck loop, a wait on hardware that never comes, a heap that ran out - stops the feeding.
+// The first timeout interrupts and switches every touch output off, the second resets.  Straight out of any reset
+// watchdogEarly() runs from .init3, before the C runtime has copied .data or cleared .bss (a couple of us after
+// the reset start-up delay), turns the watchdog off again and drives the touch lines low.  Watchdog, brown-out
+// and external resets are kept in a small EEPROM log with what the sequencer was doing at the time (shell: resets).
+// Brown-out resets need the BODLEVEL fuse
+#define WATCHDOG_MAGIC 0x5744 // "WD"
+#define WATCHDOG_LOG_SIZE 16
+#define WATCHDOG_LOG_CAUSES ((1<<WDRF) | (1<<BORF) | (1<<EXTRF)) // power-on resets are not logged
+
+// what the loop was doing at the last feed
+#define WATCHDOG_RUNNING 1
+#define WATCHDOG_RECORDING 2
+#define WATCHDOG_FAULT 4 // watchdogFault() stopped the feeding
+#define WATCHDOG_UNKNOWN 0xFF // the context did not survive the reset
+
+// every pin a touch can be driven from, the touch port (pins.h) and the wave outputs
+#define WATCHDOG_PORTD_MASK ((WAVE_CLAIMS(WAVE_OC0A) ? (1<<PIND6) : 0) | (WAVE_CLAIMS(WAVE_OC0B) ? (1<<PIND5) : 0) \
+	| (WAVE_CLAIMS(WAVE_OC2B) ? (1<<PIND3) : 0))
+#define WATCHDOG_PORTB_MASK WAVE_LED_MASK
+#define WATCHDOG_RELEASE(port, mask) ((mask) | (PINS_TOUCH_PORT == (port) ? PINS_TOUCH_MASK : 0))
+
+#if CONF_WATCHDOG_ENABLED && CLOCK_IDLE_PRESCALER > 7
+#error "idle sleep wakes on a Timer1 overflow, at /256 that is later than the idle watchdog timeout"
+#endif
+
+struct ResetEntry
+{
+	uint8_t Cause; // MCUSR, 0xFF for an empty entry
+	uint8_t Context;
+	uint16_t RunMS; // how far into the run it was
+};
+
+struct ResetLog
+{
+	uint8_t Next; // the entry written next
+	struct ResetEntry Entry[WATCHDOG_LOG_SIZE];
+};
+
+// kept across a reset, the C runtime does not clear .noinit
+struct WatchdogContext
+{
+	uint16_t Magic;
+	uint8_t Flags;
+	uint16_t RunMS;
+};
+
+EEMEM struct ResetLog ResetLog;
+
+struct WatchdogContext WatchdogContext __attribute__((section(".noinit")));
+unsigned char WatchdogResetCause __attribute__((section(".noinit")));
+unsigned long WatchdogTicks; // state->Ticks at the last feed
+unsigned char WatchdogTimeout; // the WDTO_ setting in use, WATCHDOG_UNKNOWN while paused
+
+// prototypes
+void watchdogEarly(void) __attribute__((naked, used, section(".init3")));
+void initializeWatchdog(void);
+void watchdogFeed(struct State *state);
+void watchdogPause(void);
+void watchdogResume(void);
+void watchdogIdle(void);
+void watchdogFault(void);
+void watchdogRelease(void);
+void watchdogLog(void);
+
+#if CONF_WATCHDOG_ENABLED
+// part of the startup code and run straight through, .init2 has already cleared r1 and set the stack pointer
+void watchdogEarly(void)
+{
+	WatchdogResetCause = MCUSR;
+	// WDRF keeps the watchdog on after a watchdog reset
+	MCUSR = 0;
+	wdt_disable();
+	// the I/O registers come out of reset as inputs, which leaves the touch lines floating
+	PINS_TOUCH_LATCH &= ~PINS_TOUCH_MASK;
+	PINS_TOUCH_DIR |= PINS_TOUCH_MASK;
+	PORTD &= ~WATCHDOG_PORTD_MASK;
+	DDRD |= WATCHDOG_PORTD_MASK;
+	PORTB &= ~WATCHDOG_PORTB_MASK;
+	DDRB |= WATCHDOG_PORTB_MASK;
+}
+#endif
+
+// called from main once everything else is set up, the slow start-up work (oscillator calibration) is done
+void initializeWatchdog(void)
+{
+	watchdogLog();
+	WatchdogContext.Magic = WATCHDOG_MAGIC;
+	WatchdogContext.Flags = 0;
+	WatchdogContext.RunMS = 0;
+	WatchdogTicks = 0;
+	watchdogResume();
+}
+
+// called from main after every pass through run(), only a pass that moved the clock on counts as progress
+void watchdogFeed(struct State *state)
+{
+	unsigned char timeout;
+
+	if (state->Ticks == WatchdogTicks || WatchdogTimeout == WATCHDOG_UNKNOWN
+		|| (WatchdogContext.Flags & WATCHDOG_FAULT))
+	{
+		return;
+	}
+	WatchdogTicks = state->Ticks;
+
+	WatchdogContext.Flags = (state->IsRunning ? WATCHDOG_RUNNING : 0) | (state->IsRecording ? WATCHDOG_RECORDING : 0);
+	WatchdogContext.RunMS = state->IsRunning ? state->DeltaTimeMS : 0;
+
+	// short while the outputs can be on, long enough for a profile save or a slow idle clock otherwise
+	timeout = state->IsRunning ? CONF_WATCHDOG_RUN_TIMEOUT : CONF_WATCHDOG_IDLE_TIMEOUT;
+	if (timeout != WatchdogTimeout)
+	{
+		WatchdogTimeout = timeout;
+		wdt_enable(timeout);
+		WDTCSR |= (1<<WDIE);
+	}
+	else
+	{
+		wdt_reset();
+		// the interrupt clears WDIE, a feed after it is a loop that came back in time
+		WDTCSR |= (1<<WDIE);
+	}
+}
+
+// around work that blocks for longer than the idle timeout: oscillator calibration and power-down
+void watchdogPause(void)
+{
+	wdt_disable();
+	WatchdogTimeout = WATCHDOG_UNKNOWN;
+}
+
+void watchdogResume(void)
+{
+	WatchdogTimeout = CONF_WATCHDOG_IDLE_TIMEOUT;
+	wdt_enable(WatchdogTimeout);
+	WDTCSR |= (1<<WDIE);
+}
+
+// called from stopRun before the adapt save, the EEPROM writes take far longer than the run timeout
+void watchdogIdle(void)
+{
+	if (WatchdogTimeout != WATCHDOG_UNKNOWN && WatchdogTimeout != CONF_WATCHDOG_IDLE_TIMEOUT)
+	{
+		watchdogResume();
+	}
+}
+
+// the firmware can not go on (no memory for the schedule), switch the outputs off and wait for the reset
+void watchdogFault(void)
+{
+	cli();
+	watchdogRelease();
+	WatchdogContext.Flags |= WATCHDOG_FAULT;
+	wdt_enable(WDTO_15MS);
+	while (true)
+	{
+	}
+}
+
+void watchdogRelease(void)
+{
+#if CONF_WAVE_ENABLED
+	waveStop();
+#endif
+	// every output drops within the same three cycles
+	ioport_write_ports_masked(WATCHDOG_RELEASE(IOPORT_PORTB, WATCHDOG_PORTB_MASK), 0,
+		WATCHDOG_RELEASE(IOPORT_PORTC, 0), 0, WATCHDOG_RELEASE(IOPORT_PORTD, WATCHDOG_PORTD_MASK), 0);
+}
+
+// add the cause of the last reset to the EEPROM log
+void watchdogLog(void)
+{
+	struct ResetEntry entry;
+	unsigned char next;
+
+	// a power-on reset can come with BORF set as the supply ramps
+	if (!(WatchdogResetCause & WATCHDOG_LOG_CAUSES) || (WatchdogResetCause & (1<<PORF)))
+	{
+		return;
+	}
+
+	entry.Cause = WatchdogResetCause;
+	entry.Context = WATCHDOG_UNKNOWN;
+	entry.RunMS = 0;
+	if (WatchdogContext.Magic == WATCHDOG_MAGIC)
+	{
+		entry.Context = WatchdogContext.Flags;
+		entry.RunMS = WatchdogContext.RunMS;
+	}
+
+	// erased EEPROM reads back as 0xFF
+	next = eeprom_read_byte(&ResetLog.Next);
+	if (next >= WATCHDOG_LOG_SIZE)
+	{
+		next = 0;
+	}
+	eeprom_update_block(&entry, &ResetLog.Entry[next], sizeof(struct ResetEntry));
+	eeprom_update_byte(&ResetLog.Next, (next + 1) % WATCHDOG_LOG_SIZE);
+}
+
+// the first timeout, the next one resets
+ISR(WDT_vect)
+{
+	watchdogRelease();
+}
+
+#endif /* WATCHDOG_H_ */
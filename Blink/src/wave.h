@@ -0,0 +1,295 @@
+/*
+ * wave.h
+ *
+ * Created: 10/20/2026 9:05:33 AM
+ *  Author: odinh
+ */
+
+
+#ifndef WAVE_H_
+#define WAVE_H_
+
+// hardware waveform taps.  A touch mapped to a compare output (CONF_WAVE_TOUCHn) is driven by the timer instead
+// of PORTD: each edge is loaded into the output compare register with the compare output mode set to set or
+// clear on match, so the pulse lands on the exact timer count whatever the CPU is doing.  The main loop only
+// loads the next edge once it is less than WAVE_LEAD_US away, edges that are already due (triggered steps, zero
+// offsets) are forced.  Timer1 is the timebase itself (1 tick = 125 ns at F_CPU), Timer0 and Timer2 run at /64 (8 us) and
+// are started in step with Timer1 through the synchronous prescaler reset, so every Timer1 count maps onto theirs
+#define WAVE_NONE 0
+#define WAVE_OC0A 1 // PD6
+#define WAVE_OC0B 2 // PD5
+#define WAVE_OC1A 3 // PB1, the green LED
+#define WAVE_OC1B 4 // PB2, the red LED
+#define WAVE_OC2B 5 // PD3, the tach input
+
+#define WAVE_LEAD_US 1000 // edges are loaded this far ahead
+#define WAVE_WINDOW_TICKS 12000 // anything further out than this after loading is taken as already due
+#define WAVE_MIN_TICKS 128 // two Timer0/Timer2 counts, anything closer is forced
+#define WAVE_SHIFT 6 // Timer0 and Timer2 count every 64 Timer1 ticks
+#define WAVE_SYNC_TICKS 2 // between reading TCNT1 and releasing the prescalers
+
+#define WAVE_COM_SET 3 // COMnx1:0, set on compare match
+#define WAVE_COM_CLEAR 2 // clear on compare match
+
+#if CONF_WAVE_ENABLED
+#define WAVE_CLAIMS(output) (CONF_WAVE_TOUCH0 == (output) || CONF_WAVE_TOUCH1 == (output) || CONF_WAVE_TOUCH2 == (output))
+#define WAVE_MASK (((CONF_WAVE_TOUCH0 != WAVE_NONE) << 0) | ((CONF_WAVE_TOUCH1 != WAVE_NONE) << 1) | ((CONF_WAVE_TOUCH2 != WAVE_NONE) << 2))
+#else
+#define WAVE_CLAIMS(output) 0
+#define WAVE_MASK 0
+#endif
+#define WAVE_USES_TIMER0 (WAVE_CLAIMS(WAVE_OC0A) || WAVE_CLAIMS(WAVE_OC0B))
+#define WAVE_USES_TIMER2 WAVE_CLAIMS(WAVE_OC2B)
+// the PORTB pins that are touch outputs
+#define WAVE_LED_MASK ((WAVE_CLAIMS(WAVE_OC1A) ? (1<<PINB1) : 0) | (WAVE_CLAIMS(WAVE_OC1B) ? (1<<PINB2) : 0))
+// setOutputs() leaves an LED pin (pins.h) alone when it is a touch output
+#define WAVE_OWNS(pin) ((WAVE_CLAIMS(WAVE_OC1A) && (pin) == IOPORT_CREATE_PIN(PORTB, 1)) \
+	|| (WAVE_CLAIMS(WAVE_OC1B) && (pin) == IOPORT_CREATE_PIN(PORTB, 2)) \
+	|| (WAVE_CLAIMS(WAVE_OC0A) && (pin) == IOPORT_CREATE_PIN(PORTD, 6)) \
+	|| (WAVE_CLAIMS(WAVE_OC0B) && (pin) == IOPORT_CREATE_PIN(PORTD, 5)) \
+	|| (WAVE_CLAIMS(WAVE_OC2B) && (pin) == IOPORT_CREATE_PIN(PORTD, 3)))
+
+#if WAVE_USES_TIMER2 && CONF_TICK_ENABLED
+#error "OC2B needs Timer2, which tick mode uses"
+#endif
+#if WAVE_USES_TIMER2 && CONF_TACH_ENABLED
+#error "OC2B is on PD3, which is the tach input"
+#endif
+#if (WAVE_USES_TIMER0 || WAVE_USES_TIMER2) && CONF_TIMEBASE_EXTERNAL
+#error "Timer0 and Timer2 only stay in step with Timer1 on the system clock, and OC0B is on T1"
+#endif
+
+// the registers behind one compare output
+struct WaveOutput
+{
+	volatile uint8_t *Control; // TCCRnA, holds the COM bits
+	uint8_t ComShift; // COMnx0
+	volatile uint8_t *Force; // the register with FOCnx
+	uint8_t ForceBit;
+	volatile uint8_t *Flags; // TIFRn
+	uint8_t Flag;
+	volatile uint8_t *Ddr;
+	volatile uint8_t *Port;
+	uint8_t Pin;
+	volatile uint8_t *Compare8; // OCRnx of Timer0 and Timer2
+	volatile uint16_t *Compare16; // OCR1x
+};
+
+#define WAVE_OUTPUT_0 { NULL, 0, NULL, 0, NULL, 0, NULL, NULL, 0, NULL, NULL }
+#define WAVE_OUTPUT_1 { &TCCR0A, COM0A0, &TCCR0B, FOC0A, &TIFR0, OCF0A, &DDRD, &PORTD, PIND6, &OCR0A, NULL }
+#define WAVE_OUTPUT_2 { &TCCR0A, COM0B0, &TCCR0B, FOC0B, &TIFR0, OCF0B, &DDRD, &PORTD, PIND5, &OCR0B, NULL }
+#define WAVE_OUTPUT_3 { &TCCR1A, COM1A0, &TCCR1C, FOC1A, &TIFR1, OCF1A, &DDRB, &PORTB, PINB1, NULL, &OCR1A }
+#define WAVE_OUTPUT_4 { &TCCR1A, COM1B0, &TCCR1C, FOC1B, &TIFR1, OCF1B, &DDRB, &PORTB, PINB2, NULL, &OCR1B }
+#define WAVE_OUTPUT_5 { &TCCR2A, COM2B0, &TCCR2B, FOC2B, &TIFR2, OCF2B, &DDRD, &PORTD, PIND3, &OCR2B, NULL }
+#define WAVE_OUTPUT(output) WAVE_OUTPUT_(output)
+#define WAVE_OUTPUT_(output) WAVE_OUTPUT_##output
+
+// where each touch is in its current step
+#define WAVE_RISE 0 // the rising edge is not loaded yet
+#define WAVE_RISE_LOADED 1
+#define WAVE_FALL 2 // the pulse is on, the falling edge is not loaded yet
+#define WAVE_DONE 3
+
+// only touches 0 - 2 can be mapped to a compare output, WAVE_MASK keeps the loops off the entries after them
+const struct WaveOutput WaveTouch[PINS_TOUCH_COUNT] = { WAVE_OUTPUT(CONF_WAVE_TOUCH0), WAVE_OUTPUT(CONF_WAVE_TOUCH1), WAVE_OUTPUT(CONF_WAVE_TOUCH2) };
+
+unsigned int WaveSync; // the Timer1 count at which Timer0 and Timer2 were at 0
+unsigned int WaveRunStart; // the Timer1 count at DeltaTime 0 of the current run
+unsigned char WavePhase[PINS_TOUCH_COUNT];
+unsigned char WaveIndex[PINS_TOUCH_COUNT]; // the step the phase belongs to
+unsigned long WaveStart[PINS_TOUCH_COUNT]; // the start the rising edge was loaded for
+
+// prototypes
+void initializeWave(void);
+void waveStart(struct State *state);
+void waveStop(void);
+void waveUpdate(struct State *state);
+unsigned char waveLoad(struct State *state, int s, unsigned long us, unsigned char mode);
+void waveMode(int s, unsigned char mode);
+
+// called from main after the oscillator calibration, which may borrow Timer2
+void initializeWave(void)
+{
+	irqflags_t flags;
+	int s;
+
+#if WAVE_USES_TIMER0
+	PRR &= ~(1<<PRTIM0);
+	TCCR0A = 0; // normal mode
+#endif
+#if WAVE_USES_TIMER2
+	PRR &= ~(1<<PRTIM2);
+	ASSR = 0;
+	TCCR2A = 0;
+#endif
+
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		if (WAVE_MASK & (1<<s))
+		{
+			waveMode(s, 0);
+			*WaveTouch[s].Port &= ~(1<<WaveTouch[s].Pin);
+			*WaveTouch[s].Ddr |= (1<<WaveTouch[s].Pin);
+		}
+	}
+
+	// hold the prescalers in reset while Timer0 and Timer2 are zeroed and started, Timer1 runs straight off the
+	// system clock and keeps counting
+	flags = cpu_irq_save();
+	GTCCR = (1<<TSM) | (1<<PSRSYNC) | (1<<PSRASY);
+#if WAVE_USES_TIMER0
+	TCNT0 = 0;
+	TCCR0B = (1<<CS01) | (1<<CS00); // /64
+#endif
+#if WAVE_USES_TIMER2
+	TCNT2 = 0;
+	TCCR2B = (1<<CS22); // /64
+#endif
+	WaveSync = TCNT1 + WAVE_SYNC_TICKS;
+	GTCCR = 0;
+	cpu_irq_restore(flags);
+}
+
+// called from startRun
+void waveStart(struct State *state)
+{
+	int s;
+
+	WaveRunStart = state->LastCount;
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		WavePhase[s] = WAVE_DONE;
+		WaveIndex[s] = 0xFF;
+		if ((WAVE_MASK & (1<<s)) && !state->IsDryRun)
+		{
+			// hand the pin to the timer, low
+			waveMode(s, WAVE_COM_CLEAR);
+			*WaveTouch[s].Force |= (1<<WaveTouch[s].ForceBit);
+		}
+	}
+}
+
+// called from stopRun, every output low and back on its PORT bit
+void waveStop(void)
+{
+	int s;
+
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		if (WAVE_MASK & (1<<s))
+		{
+			waveMode(s, WAVE_COM_CLEAR);
+			*WaveTouch[s].Force |= (1<<WaveTouch[s].ForceBit);
+			waveMode(s, 0);
+		}
+	}
+}
+
+// called from setOutputs on every pass of a real run
+void waveUpdate(struct State *state)
+{
+	unsigned char loaded;
+	int s;
+
+	if (!state->IsRunning || state->IsDryRun)
+	{
+		return;
+	}
+
+	for (s = 0; s < PINS_TOUCH_COUNT; s++)
+	{
+		if (!(WAVE_MASK & (1<<s)))
+		{
+			continue;
+		}
+
+		if (WaveIndex[s] != state->Index_Touch[s])
+		{
+			// the sequencer moved on to the next step
+			WaveIndex[s] = state->Index_Touch[s];
+			WavePhase[s] = state->Touch[s] != NULL && state->Touch[s]->Duration > 0 ? WAVE_RISE : WAVE_DONE;
+		}
+		else if (WavePhase[s] == WAVE_RISE_LOADED && WaveStart[s] != state->Start_Touch[s])
+		{
+			// an rpm or analog trigger pulled the start in
+			WavePhase[s] = WAVE_RISE;
+		}
+
+		switch (WavePhase[s])
+		{
+		case WAVE_RISE:
+			loaded = waveLoad(state, s, state->Start_Touch[s], WAVE_COM_SET);
+			if (loaded)
+			{
+				WaveStart[s] = state->Start_Touch[s];
+				// a forced edge is already out
+				WavePhase[s] = loaded == 2 ? WAVE_FALL : WAVE_RISE_LOADED;
+			}
+			break;
+		case WAVE_RISE_LOADED:
+			if (*WaveTouch[s].Flags & (1<<WaveTouch[s].Flag))
+			{
+				WavePhase[s] = WAVE_FALL;
+			}
+			break;
+		case WAVE_FALL:
+			if (waveLoad(state, s, state->End_Touch[s], WAVE_COM_CLEAR))
+			{
+				WavePhase[s] = WAVE_DONE;
+			}
+			break;
+		}
+	}
+}
+
+// load the edge at us (run time) into the compare output of touch s once it is close enough.  0 when it is still
+// too far out, 1 when it is loaded, 2 when it was due and has been forced
+unsigned char waveLoad(struct State *state, int s, unsigned long us, unsigned char mode)
+{
+	const struct WaveOutput *output = &WaveTouch[s];
+	unsigned int target, remaining;
+	unsigned char result = 1;
+	irqflags_t flags;
+
+	if (us > state->DeltaTime && us - state->DeltaTime > WAVE_LEAD_US)
+	{
+		return 0;
+	}
+
+	target = WaveRunStart + (unsigned int)(us * TICKS_PER_US);
+
+	flags = cpu_irq_save();
+	waveMode(s, mode);
+	remaining = target - TCNT1;
+	if (remaining < WAVE_MIN_TICKS || remaining > WAVE_WINDOW_TICKS)
+	{
+		*output->Force |= (1<<output->ForceBit);
+		result = 2;
+	}
+	else
+	{
+		if (output->Compare16 != NULL)
+		{
+			*output->Compare16 = target;
+		}
+		else
+		{
+			// the nearest Timer0/Timer2 count
+			*output->Compare8 = (unsigned char)((unsigned int)(target - WaveSync + (1 << (WAVE_SHIFT - 1))) >> WAVE_SHIFT);
+		}
+		*output->Flags = (1<<output->Flag);
+	}
+	cpu_irq_restore(flags);
+
+	return result;
+}
+
+// COMnx bits of touch s, 0 disconnects the compare output
+void waveMode(int s, unsigned char mode)
+{
+	const struct WaveOutput *output = &WaveTouch[s];
+
+	*output->Control = (*output->Control & ~(3 << output->ComShift)) | (mode << output->ComShift);
+}
+
+#endif /* WAVE_H_ */